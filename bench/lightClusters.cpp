@@ -0,0 +1,40 @@
+// Times LightClusters::assign on the CPU for growing light counts.
+//
+//   g++ -std=c++20 -O3 -march=native -Iinclude bench/lightClusters.cpp \
+//     src/lightClusters.cpp -o lightClustersBench
+#include "lightClusters.h"
+#include <chrono>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+int
+main()
+{
+  const float near = 0.1f, far = 400.0f;
+  LightClusters clusters;
+  clusters.setProjection(
+    glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, near, far), near, far);
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+  std::uniform_real_distribution<float> depth(1.0f, 250.0f);
+  for (int count : { 16, 64, 256, 1024 }) {
+    LightSpheres lights;
+    for (int i = 0; i < count; i++) {
+      lights.push(glm::vec3(spread(random), spread(random), -depth(random)),
+                  15.0f);
+    }
+    const int iterations = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      clusters.assign(lights);
+    }
+    std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+    std::printf("%5d lights: %8.1f us/assign, %zu indices\n",
+                count,
+                elapsed.count() / iterations,
+                clusters.getLightIndices().size());
+  }
+}
@@ -0,0 +1,60 @@
+// Times the shm upload row converters over 4K frames for every DRM format.
+//
+//   g++ -std=c++20 -O3 -march=native -Iinclude bench/pixelConvert.cpp \
+//     src/wayland/pixelConvert.cpp -o pixelConvertBench
+#include "wayland/pixelConvert.h"
+#include <chrono>
+#include <cstdio>
+#include <drm_fourcc.h>
+#include <random>
+#include <vector>
+
+int
+main()
+{
+  const int width = 3840, height = 2160;
+  const size_t stride = size_t(width) * 4;
+  std::vector<uint8_t> src(stride * height), dst(stride * height);
+  std::mt19937 random(1);
+  for (auto& byte : src) {
+    byte = uint8_t(random());
+  }
+
+  struct Format
+  {
+    const char* name;
+    uint32_t fourcc;
+  };
+  const Format formats[] = {
+    { "ARGB8888", DRM_FORMAT_ARGB8888 },
+    { "XRGB8888", DRM_FORMAT_XRGB8888 },
+    { "ABGR8888", DRM_FORMAT_ABGR8888 },
+    { "XBGR8888", DRM_FORMAT_XBGR8888 },
+    { "BGRA8888", DRM_FORMAT_BGRA8888 },
+    { "BGRX8888", DRM_FORMAT_BGRX8888 },
+    { "RGBA8888", DRM_FORMAT_RGBA8888 },
+    { "RGBX8888", DRM_FORMAT_RGBX8888 },
+    { "ARGB2101010", DRM_FORMAT_ARGB2101010 },
+    { "XRGB2101010", DRM_FORMAT_XRGB2101010 },
+    { "ABGR2101010", DRM_FORMAT_ABGR2101010 },
+    { "XBGR2101010", DRM_FORMAT_XBGR2101010 },
+  };
+  for (auto& format : formats) {
+    RowConverter convert = rowConverterFor(format.fourcc);
+    const int frames = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+      for (int y = 0; y < height; y++) {
+        convert(src.data() + y * stride, dst.data() + y * stride, width);
+      }
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+    double perFrame = elapsed.count() / frames;
+    std::printf("%-12s %7.2f ms/frame %6.2f GB/s  (%u)\n",
+                format.name,
+                perFrame,
+                src.size() / (perFrame * 1e6),
+                dst[dst.size() / 2]);
+  }
+}
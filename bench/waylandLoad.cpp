@@ -0,0 +1,781 @@
+// Compositor throughput under synthetic client load. Starts the compositor on
+// the wlroots headless backend with llvmpipe, then grows a population of
+// wl_shm clients (1, 2, 4 ... --max-clients), each repainting a --region of
+// its window --rate times a second, and measures every step for --seconds.
+// Results go out as JSON, one object per client count:
+//
+//   frames            output commits that showed a new frame
+//   client_commits    buffers the synthetic clients committed
+//   upload_mb_s       shm bytes uploaded: presented buffers times the region
+//   cpu_ms_per_frame  compositor user+system CPU time per frame
+//   latency_*_ms      commit-to-present latency from STATUS over the step
+//                     (reset with RESET_LATENCY after warmup), median
+//                     client for p50 and worst client for p95/p99
+//   dropped_commits   client buffers replaced before they were drawn
+//
+// Built as the waylandLoadBench target; run it from the repository root so
+// ./launch and ./build/matrix resolve:
+//
+//   ./build/waylandLoadBench --max-clients 64 --out load.json
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <poll.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <wayland-client.h>
+#include <zmq/zmq.hpp>
+#include "protos/api.pb.h"
+#include "xdg-shell-client-protocol.h"
+
+using namespace std::chrono;
+
+namespace {
+
+const char* kTitlePrefix = "wl-load-";
+
+struct Options
+{
+  std::string matrix = "./build/matrix";
+  double seconds = 5.0;
+  double warmup = 1.0;
+  double rate = 60.0;
+  int width = 640;
+  int height = 480;
+  int regionWidth = 128;
+  int regionHeight = 128;
+  int maxClients = 64;
+  int port = 47900;
+  std::string out;
+};
+
+bool
+parseSize(const char* text, int* width, int* height)
+{
+  return std::sscanf(text, "%dx%d", width, height) == 2 && *width > 0 &&
+         *height > 0;
+}
+
+bool
+parseOptions(int argc, char** argv, Options* options)
+{
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      return false;
+    }
+    i++;
+    if (arg == "--matrix") {
+      options->matrix = value;
+    } else if (arg == "--seconds") {
+      options->seconds = std::atof(value);
+    } else if (arg == "--warmup") {
+      options->warmup = std::atof(value);
+    } else if (arg == "--rate") {
+      options->rate = std::atof(value);
+    } else if (arg == "--size") {
+      if (!parseSize(value, &options->width, &options->height)) {
+        return false;
+      }
+    } else if (arg == "--region") {
+      if (!parseSize(value, &options->regionWidth, &options->regionHeight)) {
+        return false;
+      }
+    } else if (arg == "--max-clients") {
+      options->maxClients = std::atoi(value);
+    } else if (arg == "--port") {
+      options->port = std::atoi(value);
+    } else if (arg == "--out") {
+      options->out = value;
+    } else {
+      return false;
+    }
+  }
+  options->regionWidth = std::min(options->regionWidth, options->width);
+  options->regionHeight = std::min(options->regionHeight, options->height);
+  return options->seconds > 0.0 && options->rate > 0.0 &&
+         options->maxClients > 0;
+}
+
+// One synthetic client on its own connection, double buffered in a single
+// shm pool. Runs on its own thread once connected.
+class LoadClient
+{
+public:
+  LoadClient(int index, const Options& options)
+    : index(index)
+    , options(options)
+  {
+  }
+  ~LoadClient();
+
+  // Maps a toplevel and commits its first full buffer.
+  bool connect();
+  void run(const std::atomic_bool& stop);
+  uint64_t getCommits() const { return commits; }
+
+private:
+  struct ShmBuffer
+  {
+    wl_buffer* buffer = nullptr;
+    uint32_t* pixels = nullptr;
+    bool busy = false;
+  };
+
+  bool createBuffers();
+  ShmBuffer* freeBuffer();
+  void paintRegion(ShmBuffer& target);
+  void commit(ShmBuffer& target, int x, int y, int w, int h);
+
+  static void handleGlobal(void* data,
+                           wl_registry* registry,
+                           uint32_t name,
+                           const char* interface,
+                           uint32_t version);
+  static void handleGlobalRemove(void*, wl_registry*, uint32_t) {}
+  static void handlePing(void*, xdg_wm_base* wmBase, uint32_t serial)
+  {
+    xdg_wm_base_pong(wmBase, serial);
+  }
+  static void handleSurfaceConfigure(void* data,
+                                     xdg_surface* xdgSurface,
+                                     uint32_t serial)
+  {
+    xdg_surface_ack_configure(xdgSurface, serial);
+    static_cast<LoadClient*>(data)->configured = true;
+  }
+  // the window keeps --size whatever the compositor suggests, so every
+  // step uploads the same amount
+  static void handleToplevelConfigure(void*,
+                                      xdg_toplevel*,
+                                      int32_t,
+                                      int32_t,
+                                      wl_array*)
+  {
+  }
+  static void handleToplevelClose(void* data, xdg_toplevel*)
+  {
+    static_cast<LoadClient*>(data)->closed = true;
+  }
+  static void handleRelease(void* data, wl_buffer*)
+  {
+    static_cast<ShmBuffer*>(data)->busy = false;
+  }
+
+  static const wl_registry_listener registryListener;
+  static const xdg_wm_base_listener wmBaseListener;
+  static const xdg_surface_listener surfaceListener;
+  static const xdg_toplevel_listener toplevelListener;
+  static const wl_buffer_listener bufferListener;
+
+  int index;
+  const Options& options;
+  wl_display* display = nullptr;
+  wl_registry* registry = nullptr;
+  wl_compositor* compositor = nullptr;
+  wl_shm* shm = nullptr;
+  xdg_wm_base* wmBase = nullptr;
+  wl_surface* surface = nullptr;
+  xdg_surface* xdgSurface = nullptr;
+  xdg_toplevel* toplevel = nullptr;
+  bool configured = false;
+  bool closed = false;
+  ShmBuffer buffers[2];
+  void* pool = MAP_FAILED;
+  size_t poolSize = 0;
+  std::atomic<uint64_t> commits = 0;
+};
+
+const wl_registry_listener LoadClient::registryListener = {
+  handleGlobal,
+  handleGlobalRemove,
+};
+const xdg_wm_base_listener LoadClient::wmBaseListener = { handlePing };
+const xdg_surface_listener LoadClient::surfaceListener = {
+  handleSurfaceConfigure
+};
+const xdg_toplevel_listener LoadClient::toplevelListener = {
+  handleToplevelConfigure,
+  handleToplevelClose,
+};
+const wl_buffer_listener LoadClient::bufferListener = { handleRelease };
+
+void
+LoadClient::handleGlobal(void* data,
+                         wl_registry* registry,
+                         uint32_t name,
+                         const char* interface,
+                         uint32_t version)
+{
+  auto* client = static_cast<LoadClient*>(data);
+  if (std::strcmp(interface, wl_compositor_interface.name) == 0) {
+    // damage_buffer needs version 4
+    client->compositor = static_cast<wl_compositor*>(wl_registry_bind(
+      registry, name, &wl_compositor_interface, std::min(version, 4u)));
+  } else if (std::strcmp(interface, wl_shm_interface.name) == 0) {
+    client->shm = static_cast<wl_shm*>(
+      wl_registry_bind(registry, name, &wl_shm_interface, 1));
+  } else if (std::strcmp(interface, xdg_wm_base_interface.name) == 0) {
+    client->wmBase = static_cast<xdg_wm_base*>(
+      wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+    xdg_wm_base_add_listener(client->wmBase, &wmBaseListener, client);
+  }
+}
+
+LoadClient::~LoadClient()
+{
+  for (auto& buffer : buffers) {
+    if (buffer.buffer) {
+      wl_buffer_destroy(buffer.buffer);
+    }
+  }
+  if (pool != MAP_FAILED) {
+    munmap(pool, poolSize);
+  }
+  if (toplevel) {
+    xdg_toplevel_destroy(toplevel);
+  }
+  if (xdgSurface) {
+    xdg_surface_destroy(xdgSurface);
+  }
+  if (surface) {
+    wl_surface_destroy(surface);
+  }
+  if (wmBase) {
+    xdg_wm_base_destroy(wmBase);
+  }
+  if (shm) {
+    wl_shm_destroy(shm);
+  }
+  if (compositor) {
+    wl_compositor_destroy(compositor);
+  }
+  if (registry) {
+    wl_registry_destroy(registry);
+  }
+  if (display) {
+    wl_display_disconnect(display);
+  }
+}
+
+bool
+LoadClient::createBuffers()
+{
+  const int stride = options.width * 4;
+  const size_t bufferSize = size_t(stride) * options.height;
+  poolSize = bufferSize * 2;
+  int fd = memfd_create("wl-load", MFD_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  if (ftruncate(fd, poolSize) < 0) {
+    close(fd);
+    return false;
+  }
+  pool = mmap(nullptr, poolSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (pool == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  wl_shm_pool* shmPool = wl_shm_create_pool(shm, fd, poolSize);
+  for (int i = 0; i < 2; i++) {
+    auto& buffer = buffers[i];
+    buffer.buffer = wl_shm_pool_create_buffer(shmPool,
+                                              i * bufferSize,
+                                              options.width,
+                                              options.height,
+                                              stride,
+                                              WL_SHM_FORMAT_XRGB8888);
+    buffer.pixels = reinterpret_cast<uint32_t*>(
+      static_cast<uint8_t*>(pool) + i * bufferSize);
+    std::fill(buffer.pixels,
+              buffer.pixels + size_t(options.width) * options.height,
+              0xff303030u);
+    wl_buffer_add_listener(buffer.buffer, &bufferListener, &buffer);
+  }
+  wl_shm_pool_destroy(shmPool);
+  close(fd);
+  return true;
+}
+
+bool
+LoadClient::connect()
+{
+  display = wl_display_connect(nullptr);
+  if (!display) {
+    return false;
+  }
+  registry = wl_display_get_registry(display);
+  wl_registry_add_listener(registry, &registryListener, this);
+  wl_display_roundtrip(display);
+  if (!compositor || !shm || !wmBase || !createBuffers()) {
+    return false;
+  }
+
+  surface = wl_compositor_create_surface(compositor);
+  xdgSurface = xdg_wm_base_get_xdg_surface(wmBase, surface);
+  xdg_surface_add_listener(xdgSurface, &surfaceListener, this);
+  toplevel = xdg_surface_get_toplevel(xdgSurface);
+  xdg_toplevel_add_listener(toplevel, &toplevelListener, this);
+  std::string title = kTitlePrefix + std::to_string(index);
+  xdg_toplevel_set_title(toplevel, title.c_str());
+  xdg_toplevel_set_app_id(toplevel, "waylandLoadBench");
+  wl_surface_commit(surface);
+  while (!configured && !closed) {
+    if (wl_display_dispatch(display) < 0) {
+      return false;
+    }
+  }
+  commit(buffers[0], 0, 0, options.width, options.height);
+  return wl_display_flush(display) >= 0;
+}
+
+LoadClient::ShmBuffer*
+LoadClient::freeBuffer()
+{
+  for (auto& buffer : buffers) {
+    if (!buffer.busy) {
+      return &buffer;
+    }
+  }
+  return nullptr;
+}
+
+void
+LoadClient::paintRegion(ShmBuffer& target)
+{
+  // a new colour per commit so every upload carries changed pixels
+  uint32_t color = 0xff000000u | (uint32_t(commits * 2654435761u) >> 8);
+  for (int y = 0; y < options.regionHeight; y++) {
+    uint32_t* row = target.pixels + size_t(y) * options.width;
+    std::fill(row, row + options.regionWidth, color);
+  }
+}
+
+void
+LoadClient::commit(ShmBuffer& target, int x, int y, int w, int h)
+{
+  wl_surface_attach(surface, target.buffer, 0, 0);
+  wl_surface_damage_buffer(surface, x, y, w, h);
+  wl_surface_commit(surface);
+  target.busy = true;
+  commits++;
+}
+
+void
+LoadClient::run(const std::atomic_bool& stop)
+{
+  const auto interval =
+    duration_cast<steady_clock::duration>(duration<double>(1.0 / options.rate));
+  auto next = steady_clock::now();
+  pollfd pfd = { wl_display_get_fd(display), POLLIN, 0 };
+  while (!stop && !closed) {
+    auto now = steady_clock::now();
+    if (now >= next) {
+      // both buffers still held by the compositor: skip this repaint
+      if (auto* target = freeBuffer()) {
+        paintRegion(*target);
+        commit(*target, 0, 0, options.regionWidth, options.regionHeight);
+      }
+      next += interval;
+      if (next < now) {
+        next = now + interval;
+      }
+    }
+    wl_display_flush(display);
+
+    while (wl_display_prepare_read(display) != 0) {
+      wl_display_dispatch_pending(display);
+    }
+    int timeoutMs = int(
+      duration_cast<milliseconds>(next - steady_clock::now()).count());
+    if (poll(&pfd, 1, std::max(timeoutMs, 0)) > 0) {
+      if (wl_display_read_events(display) < 0) {
+        return;
+      }
+    } else {
+      wl_display_cancel_read(display);
+    }
+    if (wl_display_dispatch_pending(display) < 0) {
+      return;
+    }
+  }
+}
+
+class Api
+{
+public:
+  explicit Api(int port)
+    : endpoint("tcp://127.0.0.1:" + std::to_string(port))
+  {
+  }
+
+  bool request(MessageType type, ApiRequestResponse* out)
+  {
+    zmq::socket_t sock(context, zmq::socket_type::req);
+    sock.set(zmq::sockopt::rcvtimeo, 3000);
+    sock.set(zmq::sockopt::sndtimeo, 3000);
+    sock.set(zmq::sockopt::linger, 100);
+    sock.connect(endpoint);
+    ApiRequest req;
+    req.set_entityid(0);
+    req.set_type(type);
+    std::string data;
+    req.SerializeToString(&data);
+    if (!sock.send(zmq::buffer(data), zmq::send_flags::none)) {
+      return false;
+    }
+    zmq::message_t reply;
+    if (!sock.recv(reply, zmq::recv_flags::none).has_value()) {
+      return false;
+    }
+    return out->ParseFromArray(reply.data(), reply.size());
+  }
+
+  bool status(EngineStatus* out)
+  {
+    ApiRequestResponse response;
+    if (!request(MessageType::STATUS, &response) || !response.has_status()) {
+      return false;
+    }
+    *out = response.status();
+    return true;
+  }
+
+private:
+  zmq::context_t context{ 1 };
+  std::string endpoint;
+};
+
+pid_t
+startCompositor(const Options& options, const std::string& runtimeDir)
+{
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+  std::string bind = "tcp://*:" + std::to_string(options.port);
+  setenv("XDG_RUNTIME_DIR", runtimeDir.c_str(), 1);
+  setenv("WLR_BACKENDS", "headless", 1);
+  setenv("WLR_RENDERER_ALLOW_SOFTWARE", "1", 1);
+  setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+  setenv("GALLIUM_DRIVER", "llvmpipe", 1);
+  setenv("MATRIX_WLROOTS_BIN", options.matrix.c_str(), 1);
+  setenv("VOXEL_API_BIND", bind.c_str(), 1);
+  unsetenv("WAYLAND_DISPLAY");
+  unsetenv("DISPLAY");
+  int log = open("/tmp/waylandLoadBench.log",
+                 O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 0644);
+  if (log >= 0) {
+    dup2(log, STDOUT_FILENO);
+    dup2(log, STDERR_FILENO);
+  }
+  execl("./launch", "./launch", "--headless", static_cast<char*>(nullptr));
+  _exit(127);
+}
+
+bool
+waitForSocket(pid_t pid, const std::string& path)
+{
+  for (int i = 0; i < 300; i++) {
+    if (std::filesystem::exists(path)) {
+      return true;
+    }
+    if (waitpid(pid, nullptr, WNOHANG) == pid) {
+      return false;
+    }
+    std::this_thread::sleep_for(milliseconds(100));
+  }
+  return false;
+}
+
+void
+stopCompositor(pid_t pid, Api& api)
+{
+  ApiRequestResponse response;
+  api.request(MessageType::QUIT, &response);
+  for (int i = 0; i < 50; i++) {
+    if (waitpid(pid, nullptr, WNOHANG) == pid) {
+      return;
+    }
+    std::this_thread::sleep_for(milliseconds(100));
+  }
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+// user+system CPU seconds of a process
+double
+cpuSeconds(pid_t pid)
+{
+  std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+  std::string stat((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  // fields after the parenthesised command name; utime and stime are the
+  // 12th and 13th of them
+  auto end = stat.rfind(')');
+  if (end == std::string::npos) {
+    return 0.0;
+  }
+  std::istringstream fields(stat.substr(end + 2));
+  std::string field;
+  unsigned long long utime = 0, stime = 0;
+  for (int i = 1; i <= 13 && fields >> field; i++) {
+    if (i == 12) {
+      utime = std::stoull(field);
+    } else if (i == 13) {
+      stime = std::stoull(field);
+    }
+  }
+  return double(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+struct Step
+{
+  int clients = 0;
+  uint64_t frames = 0;
+  uint64_t clientCommits = 0;
+  double uploadMbPerSecond = 0.0;
+  double cpuMsPerFrame = 0.0;
+  double p50Ms = 0.0;
+  double p95Ms = 0.0;
+  double p99Ms = 0.0;
+  uint64_t presented = 0;
+  uint64_t dropped = 0;
+};
+
+bool
+isLoadClient(const ClientLatency& latency)
+{
+  return latency.title().rfind(kTitlePrefix, 0) == 0;
+}
+
+Step
+measure(int clients,
+        const EngineStatus& before,
+        const EngineStatus& after,
+        uint64_t clientCommits,
+        double cpu,
+        const Options& options)
+{
+  Step step;
+  step.clients = clients;
+  step.frames = after.frames_presented() - before.frames_presented();
+  step.clientCommits = clientCommits;
+  if (step.frames > 0) {
+    step.cpuMsPerFrame = cpu * 1000.0 / step.frames;
+  }
+
+  std::map<int64_t, const ClientLatency*> start;
+  for (auto& latency : before.client_latency()) {
+    start[latency.entity_id()] = &latency;
+  }
+  std::vector<double> p50s;
+  for (auto& latency : after.client_latency()) {
+    if (!isLoadClient(latency)) {
+      continue;
+    }
+    uint64_t presented = latency.presented();
+    uint64_t dropped = latency.dropped_commits();
+    if (auto it = start.find(latency.entity_id()); it != start.end()) {
+      presented -= it->second->presented();
+      dropped -= it->second->dropped_commits();
+    }
+    step.presented += presented;
+    step.dropped += dropped;
+    if (latency.samples() > 0) {
+      p50s.push_back(latency.p50_ms());
+      step.p95Ms = std::max(step.p95Ms, latency.p95_ms());
+      step.p99Ms = std::max(step.p99Ms, latency.p99_ms());
+    }
+  }
+  if (!p50s.empty()) {
+    std::nth_element(p50s.begin(), p50s.begin() + p50s.size() / 2, p50s.end());
+    step.p50Ms = p50s[p50s.size() / 2];
+  }
+  // every presented buffer was imported with (at least) the repainted region
+  double regionBytes = double(options.regionWidth) * options.regionHeight * 4;
+  step.uploadMbPerSecond =
+    step.presented * regionBytes / (options.seconds * 1e6);
+  return step;
+}
+
+void
+writeJson(FILE* out, const Options& options, const std::vector<Step>& steps)
+{
+  std::fprintf(out,
+               "{\n"
+               "  \"backend\": \"headless\",\n"
+               "  \"renderer\": \"llvmpipe\",\n"
+               "  \"seconds\": %.3f,\n"
+               "  \"rate_hz\": %.3f,\n"
+               "  \"window\": [%d, %d],\n"
+               "  \"region\": [%d, %d],\n"
+               "  \"steps\": [\n",
+               options.seconds,
+               options.rate,
+               options.width,
+               options.height,
+               options.regionWidth,
+               options.regionHeight);
+  for (size_t i = 0; i < steps.size(); i++) {
+    const Step& step = steps[i];
+    std::fprintf(out,
+                 "    {\"clients\": %d, \"frames\": %llu, \"fps\": %.2f, "
+                 "\"client_commits\": %llu, \"upload_mb_s\": %.2f, "
+                 "\"cpu_ms_per_frame\": %.3f, \"latency_p50_ms\": %.3f, "
+                 "\"latency_p95_ms\": %.3f, \"latency_p99_ms\": %.3f, "
+                 "\"presented\": %llu, \"dropped_commits\": %llu}%s\n",
+                 step.clients,
+                 (unsigned long long)step.frames,
+                 step.frames / options.seconds,
+                 (unsigned long long)step.clientCommits,
+                 step.uploadMbPerSecond,
+                 step.cpuMsPerFrame,
+                 step.p50Ms,
+                 step.p95Ms,
+                 step.p99Ms,
+                 (unsigned long long)step.presented,
+                 (unsigned long long)step.dropped,
+                 i + 1 < steps.size() ? "," : "");
+  }
+  std::fprintf(out, "  ]\n}\n");
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  Options options;
+  if (!parseOptions(argc, argv, &options)) {
+    std::fprintf(stderr,
+                 "usage: %s [--matrix BIN] [--seconds S] [--warmup S] "
+                 "[--rate HZ] [--size WxH] [--region WxH] "
+                 "[--max-clients N] [--port P] [--out FILE]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  char runtimeTemplate[] = "/tmp/waylandLoadBench-XXXXXX";
+  if (!mkdtemp(runtimeTemplate)) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+  std::string runtimeDir = runtimeTemplate;
+  pid_t pid = startCompositor(options, runtimeDir);
+  Api api(options.port);
+  // the compositor has the runtime directory to itself, so it gets wayland-0
+  setenv("XDG_RUNTIME_DIR", runtimeDir.c_str(), 1);
+  setenv("WAYLAND_DISPLAY", "wayland-0", 1);
+  EngineStatus status;
+  bool ready = waitForSocket(pid, runtimeDir + "/wayland-0");
+  for (int i = 0; ready && i < 50 && !api.status(&status); i++) {
+    std::this_thread::sleep_for(milliseconds(200));
+  }
+  if (!ready || !status.total_entities()) {
+    std::fprintf(stderr,
+                 "compositor didn't come up, see /tmp/waylandLoadBench.log\n");
+    stopCompositor(pid, api);
+    std::filesystem::remove_all(runtimeDir);
+    return 1;
+  }
+
+  std::atomic_bool stop = false;
+  std::vector<std::unique_ptr<LoadClient>> clients;
+  std::vector<std::thread> threads;
+  std::vector<Step> steps;
+  bool failed = false;
+  for (int count = 1; count <= options.maxClients && !failed; count *= 2) {
+    while (int(clients.size()) < count) {
+      auto client =
+        std::make_unique<LoadClient>(int(clients.size()), options);
+      if (!client->connect()) {
+        std::fprintf(stderr, "client %zu failed to connect\n", clients.size());
+        failed = true;
+        break;
+      }
+      threads.emplace_back(&LoadClient::run, client.get(), std::cref(stop));
+      clients.push_back(std::move(client));
+    }
+    if (failed) {
+      break;
+    }
+    std::this_thread::sleep_for(duration<double>(options.warmup));
+
+    auto commits = [&]() {
+      uint64_t total = 0;
+      for (auto& client : clients) {
+        total += client->getCommits();
+      }
+      return total;
+    };
+    // percentiles from this step only, not the lighter ones before it
+    ApiRequestResponse reset;
+    EngineStatus before, after;
+    if (!api.request(MessageType::RESET_LATENCY, &reset) || !reset.success()) {
+      failed = true;
+      break;
+    }
+    uint64_t commitsBefore = commits();
+    double cpuBefore = cpuSeconds(pid);
+    if (!api.status(&before)) {
+      failed = true;
+      break;
+    }
+    std::this_thread::sleep_for(duration<double>(options.seconds));
+    if (!api.status(&after)) {
+      failed = true;
+      break;
+    }
+    double cpu = cpuSeconds(pid) - cpuBefore;
+    steps.push_back(measure(count,
+                            before,
+                            after,
+                            commits() - commitsBefore,
+                            cpu,
+                            options));
+    std::fprintf(stderr,
+                 "%2d clients: %6.1f fps, %7.2f MB/s upload, p99 %6.2f ms\n",
+                 count,
+                 steps.back().frames / options.seconds,
+                 steps.back().uploadMbPerSecond,
+                 steps.back().p99Ms);
+  }
+
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  clients.clear();
+  stopCompositor(pid, api);
+  std::filesystem::remove_all(runtimeDir);
+
+  FILE* out = options.out.empty() ? stdout : std::fopen(options.out.c_str(), "w");
+  if (!out) {
+    std::perror(options.out.c_str());
+    return 1;
+  }
+  writeJson(out, options, steps);
+  if (out != stdout) {
+    std::fclose(out);
+  }
+  return failed ? 1 : 0;
+}
@@ -111,6 +111,18 @@ class Client:
         )
         return self._send(apiRequest)
 
+    def capture_frame(self, raw=False):
+        """Next presented frame as (width, height, data): PNG bytes, or RGBA8
+        rows when raw is set. None if the capture failed."""
+        capture_msg = api_pb2.CaptureFrame(raw=raw)
+        apiRequest = api_pb2.ApiRequest(
+            entityId=0, type="CAPTURE_FRAME", captureFrame=capture_msg
+        )
+        response = self._send(apiRequest)
+        if not response.success:
+            return None
+        return response.frame.width, response.frame.height, response.frame.data
+
 
 if __name__ == "__main__":
     client = Client()
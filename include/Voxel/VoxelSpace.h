@@ -6,6 +6,7 @@
 #include <glm/vec3.hpp>
 
 class RenderedVoxelSpace;
+class GlStateTracker;
 
 class Voxel
 {
@@ -42,7 +43,7 @@ public:
   void upload(const std::vector<glm::vec3>& positions,
               const std::vector<glm::vec3>& barycentrics,
               const std::vector<glm::vec3>& colors);
-  void draw() const;
+  void draw(GlStateTracker&) const;
 
 private:
   void destroy();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// In-world app quads span [-kAppQuadHalfWidth, kAppQuadHalfWidth] by
+// [-halfHeight, halfHeight] in their local space, where halfHeight keeps the
+// screen's aspect ratio; localToWorld is the Positionable model matrix times
+// the app's height scalar.
+constexpr float kAppQuadHalfWidth = 0.5f;
+
+inline float
+appQuadHalfHeight(float screenWidth, float screenHeight)
+{
+  return screenHeight / screenWidth / 2.0f;
+}
+
+// Pixels covered by the screen-space bounding rectangle of an app quad,
+// clipped to the viewport. Zero when the quad lies entirely outside the view
+// frustum; the whole viewport when it straddles the eye plane.
+float
+projectedAppArea(const glm::mat4& viewProjection,
+                 const glm::mat4& localToWorld,
+                 float halfWidth,
+                 float halfHeight,
+                 float viewportWidth,
+                 float viewportHeight);
+
+// Resolution LOD: level L asks the client for 1/2^L of its full size along
+// each axis. Levels only step down once the quad covers well under half of
+// the current resolution, and step back up as soon as it covers more than
+// the current one, so an app sitting near a threshold doesn't keep being
+// reconfigured.
+constexpr int kMaxResolutionLod = 3;
+constexpr float kResolutionLodHysteresis = 0.75f;
+// never configure an app smaller than this along either axis
+constexpr int kMinLodDimension = 128;
+
+int
+resolutionLodLevel(int currentLevel,
+                   float projectedPixels,
+                   int fullWidth,
+                   int fullHeight);
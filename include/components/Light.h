@@ -4,17 +4,32 @@
 #include <functional>
 #include "glm/glm.hpp"
 
-class Light {
-  static unsigned int nextTextureUnit;
-  unsigned int depthMapFBO;
-  const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
+class ShadowAtlas;
 
+class Light {
   void lightspaceTransform(glm::vec3);
 public:
-  unsigned int textureUnit;
-  unsigned int depthCubemap;
   Light(glm::vec3 color);
-  void renderDepthMap(glm::vec3 lightPos, std::function<void()>);
+  // renders into this light's ShadowAtlas slot, one renderFace call per
+  // cube face
+  void renderDepthMap(ShadowAtlas&,
+                      glm::vec3 lightPos,
+                      std::function<void(int face)> renderFace);
+  // the depth map stays cached until something invalidates it
+  void invalidateShadow();
+  bool shadowDirty = true;
+  // nowSeconds() when shadowDirty was last set
+  double dirtySince = 0;
+  // assigned by systems::renderShadowMaps; lights without a slot are
+  // unshadowed
+  int shadowSlot = -1;
+  int shadowResolution = 0;
+  // resolution the map in the slot was rendered at, which is what gets
+  // sampled until a map at shadowResolution replaces it
+  int mappedResolution = 0;
+  // the slot holds this light's map (if maybe an outdated one) rather than
+  // whatever its previous holder left there
+  bool shadowMapped = false;
   glm::vec3 color;
   std::vector<glm::mat4> shadowTransforms;
   float nearPlane;
@@ -0,0 +1,17 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+
+// Simulation-side copy of a moving entity's transform. The fixed-step
+// movement systems integrate into pos/rotation; the Positionable that the
+// renderer reads is interpolated between the previous and current step.
+struct SimulatedTransform {
+  glm::vec3 previousPos;
+  glm::vec3 pos;
+  glm::quat previousRotation;
+  glm::quat rotation;
+  // last state written into the Positionable; only the change from it is
+  // applied, so other writers moving the entity meanwhile are kept
+  glm::vec3 presentedPos;
+  glm::quat presentedRotation;
+};
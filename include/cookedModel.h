@@ -0,0 +1,42 @@
+#pragma once
+
+#include "components/BoundingSphere.h"
+#include "mesh.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Cooked models are the post-processed output of an assimp import written
+// out flat, so that loading a model again is an mmap and a copy instead of a
+// full import. Files are named after a hash of the source file's bytes; a
+// model that changes on disk simply gets a new cooked file.
+//
+// Layout (native endianness, every section 4-byte aligned):
+//   header   magic "HMCM", version, mesh count, bounding sphere
+//   per mesh vertex count, index count, texture count
+//            vertices (Vertex as laid out in memory)
+//            indices (uint32)
+//            textures: type length, path length, type bytes, path bytes
+//
+// Texture images are not embedded, only the paths the meshes refer to.
+
+// FNV-1a over the file's contents; empty if it can't be read
+std::optional<uint64_t>
+hashModelFile(const std::string& path);
+
+std::string
+cookedModelPath(const std::string& cacheDir, uint64_t hash);
+
+// false if the file is missing, truncated or from another format version
+bool
+readCookedModel(const std::string& path,
+                std::vector<MeshData>& meshes,
+                BoundingSphere& bounds);
+
+// writes to a temporary file and renames it into place, so a reader never
+// sees a partial file
+bool
+writeCookedModel(const std::string& path,
+                 const std::vector<MeshData>& meshes,
+                 const BoundingSphere& bounds);
@@ -34,6 +34,13 @@ class Engine
   std::vector<double> frameTimes;
   int frameIndex = 0;
   double fps = 0.0;
+  // render-thread time per frame for finishing model loads
+  double modelUploadBudget = 0.004;
+  // while idle, still render at least this often (0 never)
+  double minFrameRate = 1.0;
+  double lastRenderTime = 0;
+  glm::vec3 renderedCameraPosition = glm::vec3(0.0f);
+  glm::vec3 renderedCameraFront = glm::vec3(0.0f);
   std::shared_ptr<spdlog::logger> logger;
   std::shared_ptr<EntityRegistry> registry;
   std::shared_ptr<EngineGui> engineGui;
@@ -50,6 +57,9 @@ class Engine
   void setupRegistry();
   void initializeMemberObjs();
   void multiplayerClientIteration(double frameStart);
+  // marks the scene for anything that changes the picture without going
+  // through an input, commit or API path
+  void markSceneChanges(double now);
 
 public:
   Engine(char** envp, EngineOptions options = {});
@@ -62,7 +72,14 @@ public:
   Controls* getControls() { return controls; }
   void action(Action action);
   void wire();
-  void frame();
+  // One engine iteration: API mutations, input, simulation and, when the
+  // scene changed, rendering. Returns whether the scene changed, i.e.
+  // whether a new frame has to be presented. With drawScene false the
+  // caller presents something else (a fullscreen app) and nothing is drawn.
+  bool frame(bool drawScene = true);
+  // Seconds until the engine needs another iteration even if nothing wakes
+  // it (in-flight loads, the minimum frame rate); negative for never.
+  double idleTimeout();
   void registerServer(shared_ptr<MultiPlayer::Server>);
   void registerClient(shared_ptr<MultiPlayer::Client>);
   void updateImGuiPointer(float xPixels, float yPixels, const bool buttons[3]);
@@ -12,6 +12,7 @@ class EntityRegistry : public entt::registry
   std::shared_ptr<SQLite::Database> db;
   std::vector<std::shared_ptr<SQLPersister>> persisters;
   std::map<int, entt::entity> entityLocator;
+  std::vector<entt::entity> damagedPositionables;
 
 public:
   EntityRegistry();
@@ -34,4 +35,8 @@ public:
   };
 
   std::optional<entt::entity> locateEntity(int entityIdForDB);
+
+  // Entities whose Positionable was damaged since the last update pass.
+  // Fed by Positionable::damage(), drained by systems::updateAll.
+  std::vector<entt::entity>& damageQueue();
 };
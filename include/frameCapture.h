@@ -0,0 +1,59 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <vector>
+
+// Asynchronous framebuffer readback. read() queues a glReadPixels into a
+// pixel-pack buffer and fences it; a later poll() maps the buffers the GPU
+// has finished with and hands them to a worker thread, which converts the
+// pixels and runs the callbacks. Nothing on the render thread waits on the
+// GPU or touches the pixels.
+//
+// Without fences or buffer mapping (GLES 2) the read is synchronous and only
+// the conversion and callbacks move to the worker.
+class FrameCapture
+{
+public:
+  // RGBA8 rows in the order the framebuffer stores them, which for the
+  // compositor's Y-inverted rendering is top row first
+  struct Frame
+  {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba;
+  };
+  // runs on a worker thread
+  typedef std::function<void(const Frame&)> Callback;
+
+  ~FrameCapture();
+  // Reads width x height pixels from the bound read framebuffer.
+  void read(int width, int height, std::vector<Callback> callbacks);
+  // Call once per frame with the GL context current.
+  void poll();
+  bool busy() const { return !readbacks.empty(); }
+
+private:
+  struct Readback
+  {
+    GLuint buffer = 0;
+    size_t capacity = 0;
+    GLsync fence = nullptr;
+    int width = 0;
+    int height = 0;
+    GLenum format = GL_RGBA;
+    std::vector<Callback> callbacks;
+    // conversion of the mapped buffer, once started
+    std::future<void> worker;
+  };
+
+  std::vector<Readback> readbacks;
+  // unmapped buffers of finished readbacks, reused by the next read()
+  std::vector<Readback> spare;
+};
+
+// PNG file contents for a captured frame.
+std::vector<uint8_t>
+encodePng(const FrameCapture::Frame&);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// View-space light spheres, SoA so the assignment kernel can test several
+// lights per instruction.
+struct LightSpheres
+{
+  std::vector<float> x, y, z, radius;
+
+  void clear();
+  void push(glm::vec3 center, float radius);
+  size_t size() const;
+};
+
+// Splits the view frustum into tilesX * tilesY screen tiles times slices
+// depth slices (exponentially spaced, so near clusters stay small) and
+// lists the lights whose spheres touch each cluster. The fragment shader
+// finds its cluster from gl_FragCoord and its view depth and only shades
+// those lights.
+//
+// Cluster c = x + y * tilesX + z * tilesX * tilesY covers lightIndices
+// [ranges[2c], ranges[2c] + ranges[2c + 1]). Light indices refer to the
+// order the spheres were pushed in.
+class LightClusters
+{
+public:
+  LightClusters(int tilesX = 16, int tilesY = 9, int slices = 24);
+
+  // Recomputes the view-space bounds of every cluster. Only needed when the
+  // projection changes; a y-flipped projection flips the tiles to match.
+  void setProjection(const glm::mat4& projection, float near, float far);
+  void assign(const LightSpheres& lights);
+
+  const std::vector<uint32_t>& getRanges() const { return ranges; }
+  const std::vector<uint32_t>& getLightIndices() const
+  {
+    return lightIndices;
+  }
+  int getTilesX() const { return tilesX; }
+  int getTilesY() const { return tilesY; }
+  int getSlices() const { return slices; }
+  size_t clusterCount() const { return size_t(tilesX) * tilesY * slices; }
+  // slice = floor(log(viewDepth) * depthScale + depthBias)
+  float getDepthScale() const { return depthScale; }
+  float getDepthBias() const { return depthBias; }
+  // ndc in [-1, 1]; viewDepth is the positive distance along -z
+  int clusterAt(glm::vec2 ndc, float viewDepth) const;
+
+private:
+  int tilesX, tilesY, slices;
+  float depthScale = 0, depthBias = 0;
+  // per cluster view-space AABB, SoA like the lights
+  std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+  std::vector<uint32_t> ranges;
+  std::vector<uint32_t> lightIndices;
+  // scratch for the lights overlapping one depth slice
+  LightSpheres sliceLights;
+  std::vector<uint32_t> sliceIndices;
+};
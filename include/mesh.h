@@ -2,6 +2,8 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <string>
+#include <utility>
+#include "renderQueue.h"
 #include "shader.h"
 
 using namespace std;
@@ -13,6 +15,14 @@ struct Vertex
   glm::vec3 Normal;
 };
 
+// Per-instance vertex data for instanced model draws. The model matrix
+// takes attribute locations 3-6 and the normal matrix 9-11.
+struct ModelInstance
+{
+  glm::mat4 model;
+  glm::mat3 normalMatrix;
+};
+
 struct MeshTexture
 {
   unsigned int id;
@@ -20,6 +30,15 @@ struct MeshTexture
   string path;
 };
 
+// CPU-side geometry of one mesh, before it has any GL objects
+struct MeshData
+{
+  vector<Vertex> vertices;
+  vector<unsigned int> indices;
+  // (texture_diffuse/texture_specular, path relative to the model)
+  vector<pair<string, string>> textures;
+};
+
 class Mesh
 {
 public:
@@ -31,11 +50,19 @@ public:
   Mesh(vector<Vertex> vertices,
        vector<unsigned int> indices,
        vector<MeshTexture> textures);
-  void Draw(Shader& shader);
+  // fills in this mesh's geometry and textures and queues the draw
+  void submit(RenderQueue&, GLuint program, DrawItem item);
+  // deletes the GL buffers; copies of a Mesh share them, so only the owning
+  // ModelAsset calls this
+  void release();
+  // sources the instance attributes of this mesh's VAO from buffer
+  void attachInstanceBuffer(unsigned int buffer);
 
 private:
   //  render data
   unsigned int VAO, VBO, EBO;
+  // sampler uniform for each texture (texture_diffuseN, ...)
+  vector<Uniform> textureUniforms;
 
   void setupMesh();
 };
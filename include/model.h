@@ -7,6 +7,10 @@
 #include <assimp/mesh.h>
 #include <assimp/scene.h>
 #include "entity.h"
+#include <functional>
+#include <future>
+#include <memory>
+#include <unordered_map>
 
 unsigned int
 TextureFromFile(const char* path, const string& directory, bool gamma = false);
@@ -25,6 +29,11 @@ struct Positionable
   bool damaged = true;
   bool isDragging = false;
   void damage();
+
+  // bound by systems::trackDamage when emplaced into a registry
+  entt::entity entity = entt::null;
+  std::vector<entt::entity>* damageQueue = nullptr;
+  bool queued = false;
 };
 
 class PositionablePersister : public SQLPersisterImpl
@@ -40,28 +49,117 @@ public:
   void depersistIfGone(entt::entity) override;
 };
 
-class Model
+// The meshes and textures loaded from one model file. Every Model naming
+// the same file shares one asset, which frees its GL objects when the last
+// of them goes away.
+//
+// Loading is staged: the file is parsed (or its cooked copy read, see
+// cookedModel.h) and its textures decoded on a worker thread into a
+// ParsedModel, then ModelAssets::upload turns that into GL objects a step at
+// a time on the render thread. Until then the asset draws
+// nothing and has an empty bounding sphere.
+class ModelAsset
 {
 public:
-  string path;
-  Model(string path);
-  void Draw(Shader& shader);
+  // CPU-side results of parsing, built off the render thread
+  struct ImageData
+  {
+    ImageData() = default;
+    ImageData(ImageData&&) noexcept;
+    ~ImageData();
+    string path;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    // from stbi_load; null if decoding failed
+    unsigned char* pixels = nullptr;
+  };
+  struct ParsedModel
+  {
+    vector<MeshData> meshes;
+    vector<ImageData> images;
+    string directory;
+    // at scale 1
+    BoundingSphere bounds = { glm::vec3(0.0f), 0.0f };
+    bool failed = false;
+  };
+
+  ModelAsset(string path);
+  ~ModelAsset();
+  ModelAsset(const ModelAsset&) = delete;
+  ModelAsset& operator=(const ModelAsset&) = delete;
+
+  void submit(RenderQueue&, GLuint program, const DrawItem& item);
+  BoundingSphere getBoundingSphere(float scale) const;
+  // replaces the instance buffer contents shared by every mesh; submit an
+  // item with instanceCount = instances.size() to draw them
+  void uploadInstances(const vector<ModelInstance>& instances);
 
-  BoundingSphere getBoundingSphere(float scale);
+  bool isReady() const { return ready; }
+  // runs once the asset is drawable (right away if it already is), with
+  // false if the file could not be loaded
+  void whenReady(function<void(bool)> callback);
 
 private:
+  friend class ModelAssets;
+  // reads the cooked copy under cacheDir if there is one, otherwise imports
+  // the file and cooks it there; an empty cacheDir always imports
+  static unique_ptr<ParsedModel> parse(string path, string cacheDir);
+  bool parsed() const;
+  // one texture or mesh worth of GL uploads; true once nothing is left
+  bool uploadStep();
+  void finish(bool success);
+
+  future<unique_ptr<ParsedModel>> parsing;
+  unique_ptr<ParsedModel> parsedModel;
+  bool ready = false;
+  bool failed = false;
+  vector<function<void(bool)>> readyCallbacks;
+
   // model data
   vector<Mesh> meshes;
+  unsigned int instanceBuffer = 0;
   vector<MeshTexture> textures_loaded;
-  string directory;
-
-  vector<Vertex> getAllVertices();
-  void loadModel(string path);
-  void processNode(aiNode* node, const aiScene* scene);
-  Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-  vector<MeshTexture> loadMaterialTextures(aiMaterial* mat,
-                                           aiTextureType type,
-                                           string typeName);
+  // at scale 1; scaling a model scales its sphere
+  BoundingSphere bounds = { glm::vec3(0.0f), 0.0f };
+};
+
+// Model files loaded so far, keyed by canonical path. Entries only hold weak
+// references, so an asset is evicted as soon as no entity uses it.
+class ModelAssets
+{
+public:
+  static shared_ptr<ModelAsset> acquire(const string& path);
+  // Finishes parsed loads with at most budgetSeconds of GL uploads (always at
+  // least one step). Returns the assets that became ready or failed.
+  static vector<shared_ptr<ModelAsset>> upload(double budgetSeconds);
+  // assets currently alive
+  static size_t size();
+  // assets still parsing or uploading
+  static size_t pending();
+  // where cooked models are read from and written to; empty disables them
+  static string& cacheDirectory();
+  static void setCacheDirectory(const string& directory);
+
+private:
+  static unordered_map<string, weak_ptr<ModelAsset>>& cache();
+  static vector<shared_ptr<ModelAsset>>& loading();
+};
+
+// Entity component: a handle to a shared ModelAsset
+class Model
+{
+public:
+  string path;
+  Model(string path);
+  void submit(RenderQueue&, GLuint program, const DrawItem& item);
+
+  BoundingSphere getBoundingSphere(float scale) const;
+  ModelAsset& getAsset() const { return *asset; }
+  const shared_ptr<ModelAsset>& getSharedAsset() const { return asset; }
+
+private:
+  shared_ptr<ModelAsset> asset;
 };
 
 class ModelPersister : public SQLPersisterImpl
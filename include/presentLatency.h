@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Commit-to-present latency of one client's buffers. Each buffer is timed
+// from its wl_surface.commit through texture import and draw to the output
+// commit that first shows it. A commit replaced by a newer one before it was
+// drawn counts as dropped.
+//
+// Times are seconds on one monotonic clock; the summary is in milliseconds.
+class PresentLatency
+{
+public:
+  static constexpr size_t SAMPLES = 512;
+
+  struct Summary
+  {
+    uint32_t samples = 0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    // mean time spent in each stage over the same samples
+    double commitToImportMs = 0.0;
+    double importToDrawMs = 0.0;
+    double drawToPresentMs = 0.0;
+    uint64_t presented = 0;
+    uint64_t dropped = 0;
+  };
+
+  // A new buffer. Uncounted commits (from apps nobody can see) are neither
+  // timed nor dropped.
+  void committed(double now, bool counted = true);
+  void imported(double now);
+  // The newest buffer went into a frame (or straight to scanout).
+  void drawn(double now);
+  // The output committed; returns the latency of the buffer it showed, or a
+  // negative value if it showed nothing new.
+  double presented(double now);
+  Summary summary() const;
+  // Forgets the timed samples so the percentiles cover only what comes
+  // next; the presented and dropped counters keep counting.
+  void resetSamples() { next = 0; }
+
+private:
+  struct Stages
+  {
+    float commitToImport;
+    float importToDraw;
+    float drawToPresent;
+  };
+
+  // newest committed buffer not yet drawn, commit < 0 when there is none
+  double pendingCommit = -1.0;
+  double pendingImport = -1.0;
+  bool pendingCounted = false;
+  // drawn buffer waiting for the output commit
+  double drawnCommit = -1.0;
+  double drawnImport = -1.0;
+  double drawnAt = -1.0;
+
+  std::array<Stages, SAMPLES> samples;
+  size_t next = 0;
+  uint64_t presentedCount = 0;
+  uint64_t droppedCount = 0;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "glad/glad.h"
+#include "shader.h"
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct MeshTexture;
+
+// Per-frame GL work, readable through STATUS. Binds that were skipped because
+// the object was already bound are counted separately so the effect of
+// sorting is visible even on a software driver.
+struct RenderStats
+{
+  uint32_t drawCalls = 0;
+  uint32_t stateChanges = 0;
+  uint32_t redundantStateChanges = 0;
+  uint32_t uniformWrites = 0;
+  uint32_t redundantUniformWrites = 0;
+};
+
+// Mirrors the program, vertex array and texture bindings the renderer makes
+// so repeated binds never reach the driver. Anything that binds GL objects
+// behind its back (imgui, wlroots, overlays) must be followed by
+// invalidate().
+class GlStateTracker
+{
+public:
+  void useProgram(Shader&);
+  void bindVertexArray(GLuint);
+  void bindTexture(unsigned int unit, GLenum target, GLuint texture);
+  void activeTexture(unsigned int unit);
+  void drawArrays(GLenum mode, GLint first, GLsizei count);
+  void drawElements(GLenum mode, GLsizei count, GLenum type);
+  void drawElementsInstanced(GLenum mode,
+                             GLsizei count,
+                             GLenum type,
+                             GLsizei instances);
+  // for draws issued by code that binds its own state
+  void countDraw();
+  void invalidate();
+
+  RenderStats& stats() { return current; }
+
+private:
+  // record a bind; returns true when it must actually be issued
+  bool change(bool redundant);
+
+  static constexpr GLuint UNKNOWN = ~0u;
+  static constexpr unsigned int TRACKED_UNITS = 32;
+  GLuint program = UNKNOWN;
+  GLuint vertexArray = UNKNOWN;
+  unsigned int activeUnit = UNKNOWN;
+  std::array<GLuint, TRACKED_UNITS> textures;
+  std::array<GLenum, TRACKED_UNITS> targets;
+  bool texturesKnown = false;
+  RenderStats current;
+};
+
+enum RenderPass : uint8_t
+{
+  DYNAMIC_OBJECT_PASS,
+  MODEL_PASS
+};
+
+struct DrawItem
+{
+  uint64_t key = 0;
+  RenderPass pass = MODEL_PASS;
+  GLuint vertexArray = 0;
+  GLenum mode = GL_TRIANGLES;
+  GLsizei count = 0;
+  // > 0 draws that many instances sourced from the VAO's instance buffer;
+  // 0 is a single draw using the model/normalMatrix below
+  GLsizei instanceCount = 0;
+  bool indexed = false;
+  // owned by the submitting mesh, which outlives the frame
+  const std::vector<MeshTexture>* textures = nullptr;
+  const std::vector<Uniform>* textureUniforms = nullptr;
+  glm::mat4 model = glm::mat4(1.0f);
+  glm::mat3 normalMatrix = glm::mat3(1.0f);
+  bool isLight = false;
+};
+
+// Draws collected for one render() call. Items are sorted by
+// (pass, program, material, vertex array) so that consecutive draws share as
+// much bound state as possible before they are executed.
+class RenderQueue
+{
+public:
+  static uint64_t
+  makeKey(RenderPass, GLuint program, GLuint material, GLuint vertexArray);
+
+  void submit(DrawItem item);
+  void sort();
+  void clear();
+  const std::vector<DrawItem>& getItems() const { return items; }
+
+private:
+  std::vector<DrawItem> items;
+};
@@ -13,7 +13,12 @@
 #include "camera.h"
 #include "WindowManager/Space.h"
 #include "gl_resource.h"
+#include "model.h"
+#include "lightClusters.h"
+#include "renderQueue.h"
+#include "shadowAtlas.h"
 #include "TypedKeyOverlay.h"
+#include "frameCapture.h"
 #include <array>
 #include <map>
 #include <memory>
@@ -35,6 +40,56 @@ enum RenderPerspective
   LIGHT
 };
 
+// std140 mirrors of the uniform blocks declared in the shaders. Every member
+// is a vec4/mat4 or fills out the tail of one, so the C++ layout already
+// matches std140 without explicit padding.
+// 3 vec4s per light keeps LightBlock inside the 16KB minimum block size
+static const int MAX_LIGHTS = 256;
+// samplers for the clustered light lists, next to ShadowAtlas::TEXTURE_UNIT
+static const unsigned int CLUSTER_RANGE_UNIT = 21;
+static const unsigned int CLUSTER_LIGHT_UNIT = 22;
+// width of the cluster light index texture; indices wrap onto more rows
+static const int CLUSTER_LIGHT_ROW = 1024;
+
+struct FrameBlock
+{
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec3 viewPos;
+  float time;
+};
+
+struct LightBlock
+{
+  // xyz is the position, w the far plane of the light's shadow map
+  glm::vec4 lightPos[MAX_LIGHTS];
+  glm::vec4 lightColor[MAX_LIGHTS];
+  // x is the first ShadowAtlas layer (or -1 when the light has no slot), y
+  // the fraction of the layer its map covers
+  glm::vec4 shadowParams[MAX_LIGHTS];
+  // every light's ambient term, which applies everywhere rather than only
+  // within the light's range
+  glm::vec4 ambientLight;
+  // LightClusters tiles x, tiles y, slices
+  glm::vec4 clusterGrid;
+  // depth scale, depth bias, tile width and height in pixels
+  glm::vec4 clusterParams;
+  int numLights;
+  int padding[3];
+};
+
+struct ShadowBlock
+{
+  glm::mat4 shadowMatrices[6];
+};
+
+enum UniformBlockBinding
+{
+  FRAME_BLOCK_BINDING = 0,
+  LIGHT_BLOCK_BINDING = 1,
+  SHADOW_BLOCK_BINDING = 2
+};
+
 class Cube;
 class World;
 class Renderer
@@ -68,6 +123,42 @@ class Renderer
   GlBuffer VOXEL_SELECTION_POSITIONS;
   GlBuffer VOXEL_SELECTION_TEX_COORDS;
 
+  GlBuffer FRAME_UBO;
+  GlBuffer LIGHT_UBO;
+  GlBuffer SHADOW_UBO;
+  ShadowAtlas shadowAtlas;
+  // which lights touch each view-frustum cluster, rebuilt every camera pass
+  LightClusters lightClusters;
+  LightSpheres viewLights;
+  glm::mat4 clusteredProjection = glm::mat4(0.0f);
+  GLuint clusterRangeTexture = 0;
+  GLuint clusterLightTexture = 0;
+  int clusterLightRows = 0;
+  void genLightClusterTextures();
+  void uploadLightClusters();
+  // last contents written to LIGHT_UBO; lights rarely change, so most frames
+  // skip the upload entirely
+  LightBlock lightBlock;
+  bool lightBlockUploaded = false;
+
+  RenderQueue renderQueue;
+  // instance lists shared by every model pass of a frame, kept between
+  // frames to reuse their storage. Each holds its asset so it can't be
+  // evicted before the passes that draw it.
+  struct ModelInstances
+  {
+    std::shared_ptr<ModelAsset> asset;
+    std::vector<ModelInstance> instances;
+  };
+  std::unordered_map<ModelAsset*, ModelInstances> modelInstances;
+  GlStateTracker glState;
+  RenderStats frameStats;
+  uint64_t presentedFrames = 0;
+  void executeRenderQueue(RenderPerspective);
+  void beginPass(RenderPass, RenderPerspective);
+  void endPass(RenderPass);
+  void publishFrameStats();
+
   bool isWireframe = false;
 
   Shader* shader;
@@ -116,7 +207,10 @@ class Renderer
   void fillBuffers();
   void setupVertexAttributePointers();
   void lightUniforms(RenderPerspective perspective,
-                     std::optional<entt::entity> fromLight);
+                     std::optional<entt::entity> fromLight,
+                     int shadowFace);
+  void genUniformBuffers();
+  void bindUniformBlocks(Shader*);
 
   int verticesInMesh = 0;
   int verticesInDynamicObjects = 0;
@@ -127,6 +221,9 @@ class Renderer
   float voxelSize = 2.0f;
   bool shadowsEnabled = true;
   unsigned int currentFbo = 0;
+  FrameCapture frameCapture;
+  // callbacks waiting for the next presented frame
+  std::vector<FrameCapture::Callback> pendingCaptures;
 
 public:
   Renderer(shared_ptr<EntityRegistry> registry,
@@ -138,8 +235,14 @@ public:
   ~Renderer();
   shared_ptr<EntityRegistry> registry;
   Camera* getCamera();
+  // a LIGHT render draws one cube face of the given light's shadow map
   void render(RenderPerspective = CAMERA,
-              std::optional<entt::entity> = std::nullopt);
+              std::optional<entt::entity> = std::nullopt,
+              int shadowFace = 0);
+  ShadowAtlas& getShadowAtlas() { return shadowAtlas; }
+  // builds and uploads the instance buffers the camera pass and every shadow
+  // pass draw from; runs once per frame, after transforms are updated
+  void updateModelInstances();
   void updateDynamicObjects(shared_ptr<DynamicObject> obj);
   void updateChunkMeshBuffers(vector<shared_ptr<ChunkMesh>>& meshes);
   void addLine(int index, Line line);
@@ -150,8 +253,25 @@ public:
   void renderSoftwareCursor(float xPixels, float yPixels, float sizePixels);
   void reloadChunk();
   void screenshotFromCurrentFramebuffer(int width, int height, unsigned int fbo = 0);
+  // Reads back the next presented frame; `done` runs on a worker thread.
+  void captureNextFrame(FrameCapture::Callback done);
+  bool captureRequested() const { return !pendingCaptures.empty(); }
+  // Starts the readbacks queued by captureNextFrame from the given
+  // framebuffer (0 for the one last rendered to), once it holds the frame.
+  void captureFrame(int width, int height, unsigned int fbo = 0);
+  // Hands finished readbacks to their callbacks; once per frame.
+  void pollCaptures() { frameCapture.poll(); }
+  bool capturesInFlight() const
+  {
+    return captureRequested() || frameCapture.busy();
+  }
   void toggleMeshing();
   void toggleWireframe();
+  // shader sources edited on disk since they were last (re)loaded
+  bool shadersChanged();
+  // Copies the app's texture 1:1 into the bound framebuffer in place of a
+  // scene render (focused fullscreen apps). False when it can't.
+  bool blitApp(WaylandApp* app);
   void wireWindowManager(WindowManager::WindowManagerPtr, shared_ptr<WindowManager::Space>);
   void addVoxels(const std::vector<glm::vec3>& positions,
                  bool replace = false,
@@ -161,6 +281,11 @@ public:
                         const glm::vec3& maxCorner);
   void setLines(const std::vector<Line>& lines);
   float getVoxelSize() const { return voxelSize; }
+  // GL work of the last completed frame (shadow passes included)
+  const RenderStats& getFrameStats() const { return frameStats; }
+  // output commits that showed a new frame, counted by the compositor
+  void framePresented() { presentedFrames++; }
+  uint64_t getPresentedFrames() const { return presentedFrames; }
   bool voxelExistsAt(const glm::vec3& worldPosition, float size) const;
 
   glm::mat4 projection;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <functional>
+
+// Engine-wide "the next frame would look different" flag. Camera movement,
+// surface commits, API mutations, animations, input and shader reloads mark
+// it; while it stays clear the compositor skips rendering and committing and
+// only sends frame-done.
+//
+// Everything here is safe to call from any thread. The waker, installed by
+// the compositor, gets the event loop to run another engine iteration, so
+// work that arrives while idle is picked up without polling.
+namespace sceneDamage {
+// something visible changed; wakes the loop if the scene was clean
+void mark();
+// new work (e.g. an API request) that may or may not change the scene
+void wake();
+// whether the scene was marked since the last call, which clears it
+bool consume();
+void setWaker(std::function<void()>);
+}
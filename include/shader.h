@@ -3,12 +3,29 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "glad/glad.h"
 #include <glm/glm.hpp>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
+// Interned uniform name. The string is looked up once, when the handle is
+// made; every Shader then maps the id to a location once per link, so
+// per-draw calls are string-free.
+class Uniform
+{
+  int index;
+
+public:
+  explicit Uniform(const std::string& name);
+  int id() const { return index; }
+  const std::string& name() const;
+};
+
+std::vector<Uniform>
+uniformArray(const std::string& name, int count);
+
 class Shader
 {
   // shader ids
@@ -22,15 +39,27 @@ class Shader
                 std::string,
                 std::optional<std::string> = std::nullopt);
   void cacheLastTimeSourceCodeChangedOnDisk();
-  bool sourceCodeChanged();
-  void restoreUniforms() const;
+  void restoreUniforms();
+
+  // Last value written to each uniform of the current program, indexed by
+  // Uniform::id(). Doubles as the redundant-write filter and as the state
+  // replayed onto a freshly linked program by reloadIfChanged.
+  struct UniformSlot
+  {
+    GLint location = -1;
+    bool resolved = false;
+    // GL type of the last value written, 0 if never written
+    GLenum type = 0;
+    float value[16];
+  };
+  std::vector<UniformSlot> uniformSlots;
+  UniformSlot& slot(Uniform);
+  bool store(UniformSlot&, GLenum type, const void* value, size_t size);
+  void upload(const UniformSlot&);
 
-  std::unordered_map<std::string, bool> boolUniforms;
-  std::unordered_map<std::string, int> intUniforms;
-  std::unordered_map<std::string, float> floatUniforms;
-  std::unordered_map<std::string, glm::vec3> vec3Uniforms;
-  std::unordered_map<std::string, glm::mat4> mat4Uniforms;
-  std::unordered_map<std::string, glm::mat3> mat3Uniforms;
+  // uniform block name -> binding point, reapplied after every relink
+  std::vector<std::pair<std::string, GLuint>> uniformBlocks;
+  void applyUniformBlock(const std::string& name, GLuint binding);
 
   std::string vertexCode;
   std::string fragmentCode;
@@ -47,6 +76,10 @@ class Shader
 public:
   // the program ID
   unsigned int ID = 0;
+  // uniform writes that reached GL / were skipped as unchanged; the renderer
+  // reads and resets these once per frame
+  unsigned int uniformWrites = 0;
+  unsigned int redundantUniformWrites = 0;
   // constructor reads and builds the shader
   Shader(std::string vertexPath, std::string fragmentPath);
   Shader(std::string vertexPath,
@@ -54,15 +87,26 @@ public:
          std::string fragmentPath);
   ~Shader();
   void reloadIfChanged();
+  // whether a source file changed on disk since the program was built
+  bool sourceCodeChanged();
   // use/activate the shader
   void use();
-  // utility uniform functions
+  // utility uniform functions; writes of an unchanged value are skipped
+  void setBool(Uniform uniform, bool value);
+  void setInt(Uniform uniform, int value);
+  void setFloat(Uniform uniform, float value);
+  void setVec3(Uniform uniform, const glm::vec3& value);
+  void setMatrix4(Uniform uniform, const glm::mat4& value);
+  void setMatrix3(Uniform uniform, const glm::mat3& value);
+  // by name, for one-off setup code
   void setBool(const std::string& name, bool value);
   void setInt(const std::string& name, int value);
   void setFloat(const std::string& name, float value);
   void setVec3(const std::string& name, const glm::vec3& value);
   void setMatrix4(const std::string& name, const glm::mat4& value);
   void setMatrix3(const std::string& name, const glm::mat3& value);
-
+  // attaches a uniform block to a buffer binding point (glBindBufferBase);
+  // blocks the program does not declare are ignored
+  void bindUniformBlock(const std::string& name, GLuint binding);
 };
 #endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Cube shadow maps for a fixed number of lights, stored six layers per slot
+// in one depth texture array. Every shadow is sampled through the same
+// texture unit however many lights exist, and memory stays at
+// SLOTS * 6 * SIZE^2 depth texels. Distant lights render into a corner of
+// their layers at a lower resolution.
+//
+// Layers follow GL cubemap face order (+X, -X, +Y, -Y, +Z, -Z), so the
+// fragment shader picks a layer and texel with the cubemap face rules.
+class ShadowAtlas
+{
+public:
+  static constexpr int SLOTS = 8;
+  static constexpr int SIZE = 1024;
+  static constexpr unsigned int TEXTURE_UNIT = 20;
+
+  ShadowAtlas() = default;
+  ShadowAtlas(const ShadowAtlas&) = delete;
+  ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+  ~ShadowAtlas();
+
+  void init();
+  // Points the framebuffer at each face of slot in turn and calls
+  // renderFace(face) with a resolution x resolution viewport.
+  void render(int slot,
+              int resolution,
+              const std::function<void(int face)>& renderFace);
+  GLuint getTexture() const { return texture; }
+
+private:
+  GLuint texture = 0;
+  GLuint framebuffer = 0;
+};
+
+static constexpr uint32_t NO_SHADOW = UINT32_MAX;
+
+// A light competing for a shadow slot
+struct ShadowCandidate
+{
+  uint32_t id;
+  // roughly how much of the screen its shadows can cover
+  float relevance;
+};
+
+// Returns which candidate holds each of slots slots (NO_SHADOW when free),
+// given the current holders. The most relevant candidates win, but a holder
+// counts as hysteresis times more relevant than it is so that lights of
+// similar relevance don't trade slots (and re-render) every frame. Holders
+// that keep a slot keep the same one.
+std::vector<uint32_t>
+assignShadowSlots(const std::vector<uint32_t>& current,
+                  std::vector<ShadowCandidate> candidates,
+                  size_t slots,
+                  float hysteresis = 1.25f);
+
+// Shadow map resolution for a light of the given range seen from distance:
+// full size up close, halving twice as the light gets further away. A light
+// already at current resolution keeps it until the distance is hysteresis
+// times past the threshold, so a camera hovering at one doesn't re-render
+// the map every frame.
+int
+shadowResolution(float distance,
+                 float range,
+                 int current = 0,
+                 float hysteresis = 1.2f);
@@ -5,5 +5,6 @@
 #include <memory>
 
 namespace systems {
-void applyRotation(std::shared_ptr<EntityRegistry>);
+// Advances every RotateMovement by one fixed step of `dt` seconds
+void applyRotation(std::shared_ptr<EntityRegistry>, double dt);
 };
@@ -5,5 +5,6 @@
 #include <memory>
 
 namespace systems {
-void applyTranslations(std::shared_ptr<EntityRegistry>);
+// Advances every TranslateMovement by one fixed step of `dt` seconds
+void applyTranslations(std::shared_ptr<EntityRegistry>, double dt);
 };
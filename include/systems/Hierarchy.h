@@ -0,0 +1,57 @@
+#pragma once
+
+#include "entity.h"
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Cached Parent/child transform hierarchy.
+//
+// Positionables stay in world space (that is what gets persisted), but every
+// child also keeps its rigid offset from its parent. Nodes are stored in
+// depth-first order, so each subtree is the contiguous range
+// [i, i + subtreeSize[i]) and a moved parent re-derives all of its
+// descendants in one linear pass. Untouched subtrees are never visited.
+class TransformHierarchy
+{
+public:
+  // entt signal listener; any change to Parent or to a Positionable's
+  // existence can reshape the tree, so the topology is rebuilt lazily.
+  void invalidate(entt::registry&, entt::entity);
+
+  // An entity's Positionable was changed directly this frame
+  void markMoved(entt::entity);
+
+  // Re-derives world transforms for every descendant of a moved node. Each
+  // descendant touched is damage()d, which queues it for the update pass.
+  void propagate(EntityRegistry&);
+
+  size_t size() const;
+
+private:
+  void rebuild(EntityRegistry&);
+  void captureLocal(int node);
+
+  bool stale = true;
+
+  // SoA, depth-first order
+  std::vector<entt::entity> entities;
+  std::vector<int> parentIndex;
+  std::vector<int> subtreeSize;
+  std::vector<glm::vec3> worldPos;
+  std::vector<glm::quat> worldRot;
+  std::vector<glm::vec3> localPos;
+  std::vector<glm::quat> localRot;
+  std::vector<uint8_t> moved;
+
+  std::unordered_map<entt::entity, int> indexOf;
+  std::vector<entt::entity> movedEntities;
+  std::vector<int> dirtyRoots;
+};
+
+namespace systems {
+TransformHierarchy& transformHierarchy(std::shared_ptr<EntityRegistry>);
+void propagateTransforms(std::shared_ptr<EntityRegistry>);
+}
@@ -1,9 +1,30 @@
 #pragma once
+#include "components/BoundingSphere.h"
 #include "entity.h"
 #include <memory>
+#include <vector>
 
 class Renderer;
 namespace systems {
+// Invalidates the cached shadow maps of lights that moved or whose range
+// overlaps the new or previous bounds of a changed shadow caster.
 void
-updateLighting(std::shared_ptr<EntityRegistry>, Renderer* renderer);
+updateLighting(std::shared_ptr<EntityRegistry>,
+               const std::vector<entt::entity>& changed,
+               const std::vector<BoundingSphere>& previousBounds);
+
+// Invalidates the shadow maps a caster that is going away was drawn into,
+// from its last bounds. Called while its Model or Positionable is being
+// destroyed.
+void
+forgetShadowCaster(EntityRegistry&, entt::entity);
+
+// Gives the ShadowAtlas slots to the most relevant lights, then re-renders
+// invalidated shadow maps, longest-waiting first, until budgetSeconds have
+// been spent (always at least one). The rest keep their previous contents
+// until a later frame gets to them.
+void
+renderShadowMaps(std::shared_ptr<EntityRegistry>,
+                 Renderer* renderer,
+                 double budgetSeconds);
 }
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "entity.h"
+#include <memory>
+
+namespace systems {
+// Spends up to budgetSeconds of the frame uploading models whose files have
+// been parsed off-thread. Entities whose model just became drawable are
+// damaged so their bounds and any shadows catch up.
+void finishModelLoads(std::shared_ptr<EntityRegistry>, double budgetSeconds);
+}
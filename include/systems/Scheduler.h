@@ -0,0 +1,79 @@
+#pragma once
+
+#include "entity.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace systems {
+
+// Creates the storages for the component types a system touches and returns
+// their ids. Storages are created up front because lazy creation from a
+// worker thread would race on the registry's pool map.
+template<typename... T>
+std::vector<entt::id_type>
+components(EntityRegistry& registry)
+{
+  (registry.storage<T>(), ...);
+  return { entt::type_hash<T>::value()... };
+}
+
+// Ids for non-ECS state shared between systems (e.g. DynamicObjectSpace)
+template<typename... T>
+std::vector<entt::id_type>
+resources()
+{
+  return { entt::type_hash<T>::value()... };
+}
+
+struct ScheduledSystem
+{
+  std::string name;
+  std::vector<entt::id_type> reads;
+  std::vector<entt::id_type> writes;
+  std::function<void()> run;
+  // anything that touches GL has to stay on the render thread
+  bool mainThread = false;
+  double lastMilliseconds = 0;
+};
+
+// Runs systems in registration order, except that systems whose declared
+// access does not conflict (no write/write or read/write overlap) run
+// concurrently on worker threads.
+class Scheduler
+{
+  std::vector<ScheduledSystem> systems;
+  // built as systems are added: a system depends on every earlier system it
+  // conflicts with
+  std::vector<std::vector<int>> dependents;
+  std::vector<int> dependencyCount;
+  bool conflicts(const ScheduledSystem&, const ScheduledSystem&) const;
+  void run(ScheduledSystem&);
+
+  // Workers are started the first time a wave has work for them and live
+  // as long as the scheduler.
+  std::vector<std::thread> workers;
+  std::mutex workMutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+  std::deque<int> queued;
+  int unfinished = 0;
+  bool stopping = false;
+  void startWorkers(size_t wanted);
+  void work();
+
+public:
+  Scheduler() = default;
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+  ~Scheduler();
+  void add(ScheduledSystem);
+  void tick();
+  const std::vector<ScheduledSystem>& getSystems() const;
+};
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "components/SimulatedTransform.h"
+#include "entity.h"
+#include <memory>
+
+namespace systems {
+// Returns the entity's simulation transform, seeding it from its
+// Positionable the first time it moves
+SimulatedTransform& simulatedTransform(std::shared_ptr<EntityRegistry>,
+                                       entt::entity);
+// The current step becomes the previous one
+void beginSimulationStep(std::shared_ptr<EntityRegistry>);
+// Moves each moving Positionable by how far the state `alpha` of the way
+// between the last two steps is from the one presented before; entities
+// that stopped moving snap to their final state and leave the simulation.
+void presentSimulation(std::shared_ptr<EntityRegistry>, float alpha);
+}
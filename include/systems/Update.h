@@ -2,9 +2,12 @@
 
 #include "entity.h"
 #include <memory>
-class Renderer;
 namespace systems {
+// Routes Positionable::damage() into the registry's damage queue, and keeps
+// cached shadow maps in step with shadow casters being added and removed.
+// Must be connected before Positionables are emplaced or loaded.
+void trackDamage(std::shared_ptr<EntityRegistry>);
 void
-updateAll(std::shared_ptr<EntityRegistry>, Renderer* renderer);
+updateAll(std::shared_ptr<EntityRegistry>);
 void update(std::shared_ptr<EntityRegistry>, entt::entity);
 }
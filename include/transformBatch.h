@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+#include <vector>
+
+// SoA inputs for computing Positionable model/normal matrices in bulk.
+//
+// Every Positionable transform is translate(pos) * R * translate(-origin) *
+// scale(s), so the model matrix is [s*R | pos - R*origin] and the normal
+// matrix is simply R / s; no general 4x4 inverse is needed.
+struct TransformBatch
+{
+  std::vector<float> px, py, pz;
+  std::vector<float> ox, oy, oz;
+  std::vector<float> qx, qy, qz, qw;
+  std::vector<float> scale;
+
+  void clear();
+  void push(glm::vec3 pos, glm::vec3 origin, glm::quat rotation, float s);
+  size_t size() const;
+};
+
+// Writes model[i] / normal[i] for i in [begin, end). Uses AVX or SSE lanes
+// when the build targets them and falls back to scalar code otherwise.
+void
+computeTransforms(const TransformBatch& batch,
+                  size_t begin,
+                  size_t end,
+                  glm::mat4* model,
+                  glm::mat3* normal);
+
+// Same as above over the whole batch, split across worker threads once the
+// batch is large enough to amortize them.
+void
+computeTransforms(const TransformBatch& batch,
+                  glm::mat4* model,
+                  glm::mat3* normal);
+
+void
+composeTransform(glm::vec3 pos,
+                 glm::vec3 origin,
+                 glm::quat rotation,
+                 float scale,
+                 glm::mat4& model,
+                 glm::mat3& normal);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "glad/glad.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Ring of pixel-unpack buffers that CPU texture uploads are staged through.
+// Pixels are written into a mapped buffer and the texture update is sourced
+// from it, so the driver copies asynchronously instead of stalling on client
+// memory. Each buffer is fenced after its upload and skipped until the GPU
+// has consumed it.
+//
+// Buffers stay persistently mapped where glBufferStorage is available
+// (desktop GL 4.4); elsewhere (GLES 3) they are mapped unsynchronized per
+// upload, which the fences make safe.
+class UploadRing
+{
+public:
+  static constexpr int BUFFERS = 4;
+
+  // Writable memory for at least `bytes` bytes in the next free buffer, or
+  // nullptr when every buffer is still in flight or GL can't map one.
+  uint8_t* map(size_t bytes);
+  // Binds the buffer returned by map() to GL_PIXEL_UNPACK_BUFFER. Pixel
+  // pointers given to glTex(Sub)Image2D are then offsets into it.
+  bool bind();
+  // Fences the buffer's reads and restores client-memory unpacking.
+  void release();
+
+private:
+  struct Slot
+  {
+    GLuint buffer = 0;
+    size_t capacity = 0;
+    GLsync fence = nullptr;
+    uint8_t* persistent = nullptr;
+  };
+
+  bool init();
+  bool reserve(Slot&, size_t bytes);
+
+  std::array<Slot, BUFFERS> slots;
+  bool initialized = false;
+  bool persistentMapping = false;
+  int next = 0;
+  int current = -1;
+};
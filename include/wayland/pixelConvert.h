@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+// Converts one row of `width` 32-bit pixels into RGBA8 (bytes R, G, B, A).
+// src and dst may not overlap and need no particular alignment.
+typedef void (*RowConverter)(const uint8_t* src, uint8_t* dst, int width);
+
+// Picks the converter for a DRM fourcc once per buffer so the per-pixel loop
+// never branches on the format. Unknown formats are copied as RGBA.
+RowConverter
+rowConverterFor(uint32_t drmFormat);
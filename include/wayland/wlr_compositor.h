@@ -242,6 +242,13 @@ struct WlrServer {
   wl_listener request_set_selection;
   wl_listener active_pointer_constraint_destroy;
   bool active_pointer_constraint_destroy_linked = false;
+  // Outputs aren't committed while the scene is unchanged, so wlroots stops
+  // sending frame events; these schedule the next one. The eventfd is written
+  // by sceneDamage (from any thread), the timer covers engine deadlines.
+  int frame_wake_fd = -1;
+  wl_event_source* frame_wake_source = nullptr;
+  wl_event_source* idle_timer = nullptr;
+  void schedule_frames();
 };
 
 // Helper APIs exposed for the main entry.
@@ -5,6 +5,7 @@
 #include <atomic>
 #include <array>
 #include <optional>
+#include <vector>
 #ifndef EGL_EGLEXT_PROTOTYPES
 #define EGL_EGLEXT_PROTOTYPES
 #endif
@@ -14,9 +15,11 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <wayland-server-core.h>
+#include <pixman-1/pixman.h>
 #include <memory>
 #include "AppSurface.h"
 #include "entity.h"
+#include "presentLatency.h"
 #include "texture.h"
 
 struct wlr_surface;
@@ -60,6 +63,25 @@ class WaylandApp : public AppSurface {
   EGLImageKHR importedImage = EGL_NO_IMAGE_KHR;
   bool needsImport = false;
   bool importedBufferLocked = false;
+  // buffer-local damage committed since the last upload
+  pixman_region32_t damage;
+  // texture storage was allocated by a CPU upload (not an imported EGLImage)
+  // and still holds the previous contents, so damaged rects are enough
+  bool textureAllocated = false;
+  // converted rows when every upload ring buffer is busy, kept across commits
+  std::vector<uint8_t> converted;
+  // screen pixels the in-world quad covered in the last camera pass
+  float projectedPixels = 0.0f;
+  // apps that were never classified (popups, layer shells) count as visible
+  bool visible = true;
+  double lastFrameDone = 0.0;
+  // configure size is the full size over 2^lodLevel; the full size is what
+  // the app last committed while at level 0
+  int lodLevel = 0;
+  int fullWidth = 0;
+  int fullHeight = 0;
+  double lastLodChange = 0.0;
+  PresentLatency latency;
   unique_ptr<Texture> texture;
 
 public:
@@ -139,6 +161,23 @@ public:
   wlr_surface* getSurface() const { return surface; }
   bool needsTextureImport() const { return needsImport; }
 
+  // Hidden apps (outside the view or under MIN_VISIBLE_PIXELS on screen) get
+  // one frame-done per HIDDEN_FRAME_INTERVAL and their commits don't trigger
+  // redraws or texture imports until they come back into view.
+  static constexpr float MIN_VISIBLE_PIXELS = 64.0f;
+  static constexpr double HIDDEN_FRAME_INTERVAL = 1.0;
+  void setProjectedPixels(float pixels);
+  float getProjectedPixels() const { return projectedPixels; }
+  bool isVisible() const { return visible; }
+  // whether the client's frame callbacks should be answered at `now`
+  bool frameDoneDue(double now);
+  // Reconfigures the app to a resolution matching its projected size (see
+  // resolutionLodLevel); full size while focused. Hidden apps keep theirs.
+  static constexpr double LOD_CHANGE_INTERVAL = 0.5;
+  void updateResolutionLod(bool focused, double now);
+  // the renderer and compositor report draws and output commits here
+  PresentLatency& getLatency() { return latency; }
+
   std::string getWindowName() override { return title; }
   int getPID() override { return clientPid; }
 
@@ -23,6 +23,7 @@
 #include "dynamicObject.h"
 #include "worldInterface.h"
 #include "model.h"
+#include "systems/Scheduler.h"
 
 class Renderer;
 
@@ -74,6 +75,17 @@ class World : public WorldInterface
   shared_ptr<DynamicObjectSpace> dynamicObjects;
   void cubeAction(Action toTake);
   void dynamicObjectAction(Action toTake);
+  // movement runs at a fixed rate, independent of how often frames happen
+  systems::Scheduler simulation;
+  double simulationStep = 1.0 / 120.0;
+  double simulationAccumulator = 0;
+  double lastTick = -1;
+  float simulationAlpha = 0;
+  // everything else runs once per frame
+  systems::Scheduler scheduler;
+  // GL time per frame spent re-rendering invalidated shadow maps
+  double shadowUpdateBudget = 0.003;
+  void initSystems();
 
 public:
   void tick() override;
@@ -121,6 +133,11 @@ public:
   {
     return dynamicObjects;
   };
+  const systems::Scheduler& getScheduler() const { return scheduler; }
+  const systems::Scheduler& getSimulationScheduler() const
+  {
+    return simulation;
+  }
 };
 
 #endif
@@ -4,10 +4,18 @@ in float Color;
 uniform bool appTransparent;
 uniform bool isApp;
 uniform int fromLightIndex;
-uniform int numLights;
-const int MAX_LIGHTS = 100;
-uniform vec3 lightPos[MAX_LIGHTS];
-uniform float far_plane[MAX_LIGHTS];
+const int MAX_LIGHTS = 256;
+layout (std140) uniform LightBlock {
+  // xyz is the position, w the far plane of the light's shadow map
+  vec4 lightPos[MAX_LIGHTS];
+  vec4 lightColor[MAX_LIGHTS];
+  // x is the first ShadowAtlas layer (or -1), y the fraction of it used
+  vec4 shadowParams[MAX_LIGHTS];
+  vec4 ambientLight;
+  vec4 clusterGrid;
+  vec4 clusterParams;
+  int numLights;
+};
 
 void main() {
   if(isApp && appTransparent) {
@@ -15,10 +23,10 @@ void main() {
   }
 
   // get distance between fragment and light source
-  float lightDistance = length(FragPos.xyz - lightPos[fromLightIndex]);
+  float lightDistance = length(FragPos.xyz - lightPos[fromLightIndex].xyz);
 
   // map to [0;1] range by dividing by far_plane
-  lightDistance = lightDistance / far_plane[fromLightIndex];
+  lightDistance = lightDistance / lightPos[fromLightIndex].w;
 
   // write this as modified depth
   gl_FragDepth = lightDistance;
@@ -1,7 +1,19 @@
 #version 330 core
 layout (location = 0) in vec3 position;
+layout (location = 3) in mat4 instanceModel;
 uniform mat4 model;
+uniform bool isInstanced;
+// which cube face of the light is being rendered
+uniform int shadowFace;
+
+// cube face view-projections of the light being rendered
+layout (std140) uniform ShadowBlock {
+  mat4 shadowMatrices[6];
+};
+
+out vec4 FragPos;
+
 void main() {
-  gl_Position = model * vec4(position, 1.0);
+  FragPos = (isInstanced ? instanceModel : model) * vec4(position, 1.0);
+  gl_Position = shadowMatrices[shadowFace] * FragPos;
 }
-
@@ -26,18 +26,37 @@ uniform bool appTransparent;
 uniform bool directRender;
 uniform bool isVoxel;
 uniform bool voxelsEnabled;
-uniform float time;
-const int MAX_LIGHTS = 10;
-uniform int numLights;
-uniform samplerCube depthCubeMap0;
-uniform samplerCube depthCubeMap1;
-uniform samplerCube depthCubeMap2;
-uniform samplerCube depthCubeMap3;
-uniform samplerCube depthCubeMap4;
-uniform vec3 lightPos[MAX_LIGHTS];
-uniform vec3 lightColor[MAX_LIGHTS];
-uniform vec3 viewPos;
-uniform float far_plane[MAX_LIGHTS];
+// every light's cube shadow map, six layers per ShadowAtlas slot
+uniform sampler2DArray shadowMaps;
+// per cluster (first index, count) into clusterLights; see LightClusters
+uniform usampler2D clusterRanges;
+uniform usampler2D clusterLights;
+const int CLUSTER_LIGHT_ROW = 1024;
+
+// Shared with every shader through uniform buffers; the layouts must match
+// FrameBlock/LightBlock in renderer.h.
+layout (std140) uniform FrameBlock {
+	mat4 view;
+	mat4 projection;
+	vec3 viewPos;
+	float time;
+};
+
+const int MAX_LIGHTS = 256;
+layout (std140) uniform LightBlock {
+	// xyz is the position, w the far plane of the light's shadow map, which
+	// is also its range
+	vec4 lightPos[MAX_LIGHTS];
+	vec4 lightColor[MAX_LIGHTS];
+	// x is the first ShadowAtlas layer (or -1), y the fraction of it used
+	vec4 shadowParams[MAX_LIGHTS];
+	vec4 ambientLight;
+	// tiles x, tiles y, slices
+	vec4 clusterGrid;
+	// depth scale, depth bias, tile size in pixels
+	vec4 clusterParams;
+	int numLights;
+};
 
 struct Material {
 	vec3 ambient;
@@ -99,14 +118,45 @@ vec4 debugTexcoordColor(vec2 coord) {
 }
 
 
-float ShadowCalculation(samplerCube depthMap, vec3 fragPos, vec3 norm, vec3 lightDir, int lightIndex)
+// The layer and coordinates a samplerCube lookup of dir would use, following
+// the cubemap face selection rules of the GL spec
+vec3 cubeFaceCoord(vec3 dir)
+{
+	vec3 a = abs(dir);
+	float face;
+	vec2 st;
+	float ma;
+	if(a.x >= a.y && a.x >= a.z) {
+		face = dir.x > 0.0 ? 0.0 : 1.0;
+		st = vec2(dir.x > 0.0 ? -dir.z : dir.z, -dir.y);
+		ma = a.x;
+	} else if(a.y >= a.z) {
+		face = dir.y > 0.0 ? 2.0 : 3.0;
+		st = vec2(dir.x, dir.y > 0.0 ? dir.z : -dir.z);
+		ma = a.y;
+	} else {
+		face = dir.z > 0.0 ? 4.0 : 5.0;
+		st = vec2(dir.z > 0.0 ? dir.x : -dir.x, -dir.y);
+		ma = a.z;
+	}
+	return vec3(0.5 * (st / ma + 1.0), face);
+}
+
+float Shadow(int i, vec3 norm, vec3 lightDir)
 {
+	vec4 params = shadowParams[i];
+	if(params.x < 0.0) {
+		return 0.0;
+	}
 	// get vector between fragment position and light position
-	vec3 fragToLight = fragPos - lightPos[lightIndex];
-	// use the light to fragment vector to sample from the depth map
-	float closestDepth = texture(depthMap, fragToLight).r;
+	vec3 fragToLight = FragPos - lightPos[i].xyz;
+	vec3 coord = cubeFaceCoord(fragToLight);
+	// smaller maps only fill the corner of their layers; keep lookups inside
+	float texel = 0.5 / (params.y * float(textureSize(shadowMaps, 0).x));
+	vec2 uv = clamp(coord.xy, texel, 1.0 - texel) * params.y;
+	float closestDepth = texture(shadowMaps, vec3(uv, params.x + coord.z)).r;
 	// it is currently in linear range between [0,1]. Re-transform back to original value
-	closestDepth *= far_plane[lightIndex];
+	closestDepth *= lightPos[i].w;
 	// now get current linear depth as the length between the fragment and light position
 	float currentDepth = length(fragToLight);
 	// now test for shadows
@@ -116,39 +166,52 @@ float ShadowCalculation(samplerCube depthMap, vec3 fragPos, vec3 norm, vec3 ligh
 	return shadow;
 }
 
-vec4 Light(int i, samplerCube depthMap) {
-	// ambient
-	//if(uAmbientStrength > 0.0011) {
-	//float ambientStrength = uAmbientStrength; // much lighter
-	//} else {
-	// strong visual attenuation in range [0.1,0.15] 
-	float ambientStrength = 0.20; // lighter 
-				      //}
-	vec3 ambient = ambientStrength * lightColor[i];
-
+vec3 Light(int i) {
 	// diffuse
 	vec3 norm = normalize(Normal);
-	vec3 lightDir = normalize(lightPos[i] - FragPos);
+	vec3 toLight = lightPos[i].xyz - FragPos;
+	vec3 lightDir = normalize(toLight);
 
 	float diff = max(dot(norm, lightDir), 0.0);
-	vec3 diffuse = diff * lightColor[i];
+	vec3 diffuse = diff * lightColor[i].rgb;
 
 	float specularStrength = 0.04;
 	float shininess = 32.0;
 	vec3 viewDir = normalize(viewPos - FragPos);
 	vec3 reflectDir = reflect(-lightDir, norm);
 	float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
-	vec3 specular = specularStrength * spec * lightColor[i];
+	vec3 specular = specularStrength * spec * lightColor[i].rgb;
 
 	// calculate shadow
 	float shadow = 0.0; 
 
 	if(SHADOWS_ENABLED) {
-		shadow = ShadowCalculation(depthMap, FragPos, norm, lightDir, i);                      
+		shadow = Shadow(i, norm, lightDir);                      
 	}
-	//float shadow = 0.0;
-	//vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;
-	return vec4(ambient + (1.0-shadow) * diffuse + specular, 1.0);
+	// fade out towards the edge of the light's range so the cluster cutoff
+	// doesn't show
+	float reach = clamp(1.0 - pow(length(toLight) / lightPos[i].w, 4.0), 0.0, 1.0);
+	return reach * reach * ((1.0-shadow) * diffuse + specular);
+}
+
+// the lights LightClusters found for this fragment's cluster
+vec3 ClusteredLights() {
+	ivec3 grid = ivec3(clusterGrid.xyz);
+	float viewDepth = -(view * vec4(FragPos, 1.0)).z;
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterParams.zw),
+			ivec2(0), grid.xy - 1);
+	int slice = clamp(int(floor(log(max(viewDepth, 0.0001)) * clusterParams.x + clusterParams.y)),
+			0, grid.z - 1);
+	uvec2 range = texelFetch(clusterRanges, ivec2(tile.x + tile.y * grid.x, slice), 0).rg;
+
+	vec3 lighting = vec3(0.0);
+	for(uint n = 0u; n < range.y; n++) {
+		int at = int(range.x + n);
+		int i = int(texelFetch(clusterLights,
+				ivec2(at % CLUSTER_LIGHT_ROW, at / CLUSTER_LIGHT_ROW), 0).r);
+		lighting += Light(i);
+	}
+	return lighting;
 }
 
 void main()
@@ -169,33 +232,9 @@ void main()
 	} else if (isModel) {
 
 		if(isLight) {
-			FragColor = vec4(lightColor[0], 1.0);
+			FragColor = vec4(lightColor[0].rgb, 1.0);
 		} else {
-			vec3 lightOutput = vec3(0.0,0.0,0.0);
-
-			if(numLights == 1) {
-				lightOutput += vec3(Light(0, depthCubeMap0));
-			} else if (numLights == 2) {
-				lightOutput += vec3(Light(0, depthCubeMap0));
-				lightOutput += vec3(Light(1, depthCubeMap1));
-
-			} else if (numLights == 3) {
-				lightOutput += vec3(Light(0, depthCubeMap0));
-				lightOutput += vec3(Light(1, depthCubeMap1));
-				lightOutput += vec3(Light(2, depthCubeMap2));
-			} else if (numLights == 4) {
-				lightOutput += vec3(Light(0, depthCubeMap0));
-				lightOutput += vec3(Light(1, depthCubeMap1));
-				lightOutput += vec3(Light(2, depthCubeMap2));
-				lightOutput += vec3(Light(3, depthCubeMap3));
-			} else if (numLights == 5) {
-				lightOutput += vec3(Light(0, depthCubeMap0));
-				lightOutput += vec3(Light(1, depthCubeMap1));
-				lightOutput += vec3(Light(2, depthCubeMap2));
-				lightOutput += vec3(Light(3, depthCubeMap3));
-				lightOutput += vec3(Light(4, depthCubeMap4));
-			}
-
+			vec3 lightOutput = ambientLight.rgb + ClusteredLights();
 
 			FragColor = vec4(lightOutput,1.0) * texture(texture_diffuse1, TexCoord);
 		}
@@ -5,6 +5,9 @@ layout (location = 1) in vec3 attr1;
 layout (location = 2) in vec3 normal;
 layout (location = 7) in vec3 barycentric;
 layout (location = 8) in vec3 voxelColorIn;
+// per-instance transforms for instanced model draws (see ModelInstance)
+layout (location = 3) in mat4 instanceModel;
+layout (location = 9) in mat3 instanceNormalMatrix;
 
 out vec2 TexCoord;
 out vec3 lineColor;
@@ -16,8 +19,12 @@ out vec3 VoxelColor;
 
 uniform mat4 meshModel;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameBlock {
+  mat4 view;
+  mat4 projection;
+  vec3 viewPos;
+  float time;
+};
 uniform mat4 bootableScale;
 uniform mat3 normalMatrix;
 uniform bool isApp;
@@ -26,6 +33,7 @@ uniform bool isMesh;
 uniform bool isLookedAt;
 uniform bool isDynamicObject;
 uniform bool isModel;
+uniform bool isInstanced;
 uniform bool directRender;
 uniform bool isVoxel;
 uniform bool voxelsEnabled;
@@ -43,10 +51,11 @@ void main()
     }
     TexCoord = attr1.xy;
   } else if(isModel) {
-    gl_Position = projection * view * model * vec4(position, 1.0);
-    FragPos = vec3(model * vec4(position, 1.0));
+    mat4 modelMatrix = isInstanced ? instanceModel : model;
+    gl_Position = projection * view * modelMatrix * vec4(position, 1.0);
+    FragPos = vec3(modelMatrix * vec4(position, 1.0));
     TexCoord = attr1.xy;
-    Normal = normalMatrix * normal;
+    Normal = (isInstanced ? instanceNormalMatrix : normalMatrix) * normal;
     Barycentric = vec3(0.0);
   } else if(isVoxel && voxelsEnabled) {
     vec4 worldPosition = model * vec4(position, 1.0);
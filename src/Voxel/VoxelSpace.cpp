@@ -1,4 +1,5 @@
 #include "Voxel/VoxelSpace.h"
+#include "renderQueue.h"
 
 #include <algorithm>
 #include <array>
@@ -160,14 +161,13 @@ RenderedVoxelSpace::upload(const std::vector<glm::vec3>& positions,
 }
 
 void
-RenderedVoxelSpace::draw() const
+RenderedVoxelSpace::draw(GlStateTracker& state) const
 {
   if (vao == 0 || vertexCount == 0) {
     return;
   }
-  glBindVertexArray(vao);
-  glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertexCount));
-  glBindVertexArray(0);
+  state.bindVertexArray(vao);
+  state.drawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertexCount));
 }
 
 void
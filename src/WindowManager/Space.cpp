@@ -1,4 +1,5 @@
 #include "WindowManager/Space.h"
+#include "appVisibility.h"
 #include "components/Bootable.h"
 #include "camera.h"
 #include "entity.h"
@@ -275,12 +276,10 @@ struct Intersection
   float dist;
 };
 
-static constexpr float kAppQuadHalfWidth = 0.5f;
-
 static float
 appQuadHalfHeight()
 {
-  return SCREEN_HEIGHT / SCREEN_WIDTH / 2.0f;
+  return ::appQuadHalfHeight(SCREEN_WIDTH, SCREEN_HEIGHT);
 }
 
 Intersection
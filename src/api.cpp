@@ -8,6 +8,7 @@
 #include "logger.h"
 #include "renderer.h"
 #include "model.h"
+#include "sceneDamage.h"
 #include "systems/KeyAndLock.h"
 #include "systems/Move.h"
 
@@ -78,6 +79,24 @@ Api::buildStatus() const
     totalEntities = static_cast<uint32_t>(view.size_hint());
     auto wlView = registry->view<WaylandApp::Component>();
     status.set_wayland_apps(static_cast<uint32_t>(wlView.size()));
+    for (auto [entity, component] : wlView.each()) {
+      if (!component.app) {
+        continue;
+      }
+      auto summary = component.app->getLatency().summary();
+      auto* latency = status.add_client_latency();
+      latency->set_entity_id(static_cast<int64_t>(entity));
+      latency->set_title(component.app->getWindowName());
+      latency->set_samples(summary.samples);
+      latency->set_p50_ms(summary.p50Ms);
+      latency->set_p95_ms(summary.p95Ms);
+      latency->set_p99_ms(summary.p99Ms);
+      latency->set_commit_to_import_ms(summary.commitToImportMs);
+      latency->set_import_to_draw_ms(summary.importToDrawMs);
+      latency->set_draw_to_present_ms(summary.drawToPresentMs);
+      latency->set_presented(summary.presented);
+      latency->set_dropped_commits(summary.dropped);
+    }
   }
   status.set_total_entities(totalEntities);
   bool waylandFocus = false;
@@ -96,6 +115,24 @@ Api::buildStatus() const
       pos->set_y(camera->position.y);
       pos->set_z(camera->position.z);
     }
+    status.set_frames_presented(renderer->getPresentedFrames());
+    auto& frame = renderer->getFrameStats();
+    auto* stats = status.mutable_render_stats();
+    stats->set_draw_calls(frame.drawCalls);
+    stats->set_state_changes(frame.stateChanges);
+    stats->set_redundant_state_changes(frame.redundantStateChanges);
+    stats->set_uniform_writes(frame.uniformWrites);
+    stats->set_redundant_uniform_writes(frame.redundantUniformWrites);
+  }
+  if (world) {
+    for (auto* scheduler :
+         { &world->getSimulationScheduler(), &world->getScheduler() }) {
+      for (auto& system : scheduler->getSystems()) {
+        auto* timing = status.add_system_timings();
+        timing->set_name(system.name);
+        timing->set_milliseconds(system.lastMilliseconds);
+      }
+    }
   }
   return status;
 }
@@ -187,6 +224,8 @@ Api::ProtobufCommandServer::poll()
           api->pendingStatus.push_back(pending);
         }
         api->releaseBatched();
+        // an idle compositor only fills STATUS on its next iteration
+        sceneDamage::wake();
         // Wait for render thread to fill response
         std::unique_lock<std::mutex> lk(api->statusMutex);
         api->statusCv.wait_for(lk, std::chrono::milliseconds(2000), [&pending]() {
@@ -212,8 +251,16 @@ Api::ProtobufCommandServer::poll()
         return;
       } else if (apiRequest.type() == LIST_ENTITIES ||
                  apiRequest.type() == GET_COMPONENT ||
+                 apiRequest.type() == CAPTURE_FRAME ||
+                 apiRequest.type() == RESET_LATENCY ||
                  apiRequest.type() == ADD_VOXELS ||
-                 apiRequest.type() == CLEAR_VOXELS) {
+                 apiRequest.type() == CLEAR_VOXELS ||
+                 (apiRequest.type() == ADD_COMPONENT &&
+                  apiRequest.addcomponent().wait_until_ready())) {
+        // model loads finish over several frames, so allow them longer
+        auto timeout = apiRequest.type() == ADD_COMPONENT
+                         ? std::chrono::milliseconds(30000)
+                         : std::chrono::milliseconds(2000);
         auto pending = std::make_shared<PendingApiResponse>();
         pending->requestId = request.id;
         {
@@ -222,10 +269,11 @@ Api::ProtobufCommandServer::poll()
         }
         batchedRequests->push(request);
         api->releaseBatched();
+        sceneDamage::wake();
         ApiRequestResponse response;
         {
           std::unique_lock<std::mutex> lk(api->responseMutex);
-          api->responseCv.wait_for(lk, std::chrono::milliseconds(2000), [&pending]() {
+          api->responseCv.wait_for(lk, timeout, [&pending]() {
             return pending->ready;
           });
           response = pending->response;
@@ -246,6 +294,7 @@ Api::ProtobufCommandServer::poll()
         batchedRequests->push(request);
       }
       api->releaseBatched();
+      sceneDamage::wake();
 
       ApiRequestResponse response;
       response.set_requestid(request.id);
@@ -536,6 +585,36 @@ Api::processBatchedRequest(BatchedRequest batchedRequest)
       fulfillPendingResponse(batchedRequest.id, response);
       break;
     }
+    case CAPTURE_FRAME: {
+      // answered from the capture worker once the next frame is read back
+      if (!renderer) {
+        ApiRequestResponse response;
+        response.set_requestid(batchedRequest.id);
+        response.set_success(false);
+        fulfillPendingResponse(batchedRequest.id, response);
+        break;
+      }
+      int64_t requestId = batchedRequest.id;
+      bool raw = batchedRequest.request.captureframe().raw();
+      renderer->captureNextFrame(
+        [this, requestId, raw](const FrameCapture::Frame& frame) {
+          ApiRequestResponse response;
+          response.set_requestid(requestId);
+          response.set_success(true);
+          auto* captured = response.mutable_frame();
+          captured->set_width(frame.width);
+          captured->set_height(frame.height);
+          captured->set_raw(raw);
+          if (raw) {
+            captured->set_data(frame.rgba.data(), frame.rgba.size());
+          } else {
+            auto png = encodePng(frame);
+            captured->set_data(png.data(), png.size());
+          }
+          fulfillPendingResponse(requestId, response);
+        });
+      break;
+    }
     case GET_COMPONENT: {
       ApiRequestResponse response;
       response.set_requestid(batchedRequest.id);
@@ -584,14 +663,23 @@ Api::processBatchedRequest(BatchedRequest batchedRequest)
     case ADD_COMPONENT: {
       const auto& add = batchedRequest.request.addcomponent();
       const auto& component = add.component();
-      if (!registry) {
-        break;
-      }
+      // answered below, or once the model is drawable
+      bool answerWhenDone = add.wait_until_ready();
+      auto answer = [&](bool success) {
+        ApiRequestResponse response;
+        response.set_requestid(batchedRequest.id);
+        response.set_success(success);
+        fulfillPendingResponse(batchedRequest.id, response);
+      };
       entt::entity target =
         static_cast<entt::entity>(batchedRequest.request.entityid());
-      if (!registry->valid(target)) {
+      if (!registry || !registry->valid(target)) {
+        if (answerWhenDone) {
+          answer(false);
+        }
         break;
       }
+      bool ok = false;
       switch (component.type()) {
         case COMPONENT_TYPE_POSITIONABLE: {
           if (!component.has_positionable()) {
@@ -614,6 +702,7 @@ Api::processBatchedRequest(BatchedRequest batchedRequest)
             registry->emplace<Positionable>(
               target, pos, origin, rotation, scale);
           }
+          ok = true;
           break;
         }
         case COMPONENT_TYPE_MODEL: {
@@ -628,6 +717,18 @@ Api::processBatchedRequest(BatchedRequest batchedRequest)
             registry->removePersistent<Model>(target);
           }
           registry->emplace<Model>(target, data.model_path());
+          if (answerWhenDone) {
+            auto requestId = batchedRequest.id;
+            registry->get<Model>(target).getAsset().whenReady(
+              [this, requestId](bool loaded) {
+                ApiRequestResponse response;
+                response.set_requestid(requestId);
+                response.set_success(loaded);
+                fulfillPendingResponse(requestId, response);
+              });
+            answerWhenDone = false;
+          }
+          ok = true;
           break;
         }
         case COMPONENT_TYPE_LIGHT: {
@@ -641,11 +742,15 @@ Api::processBatchedRequest(BatchedRequest batchedRequest)
           } else {
             registry->emplace<Light>(target, color);
           }
+          ok = true;
           break;
         }
         default:
           break;
       }
+      if (answerWhenDone) {
+        answer(ok);
+      }
       break;
     }
     case DELETE_COMPONENT: {
@@ -737,6 +842,21 @@ Api::processBatchedRequest(BatchedRequest batchedRequest)
       // STATUS requests are handled synchronously in poll().
       break;
     }
+    case RESET_LATENCY: {
+      if (registry) {
+        for (auto [entity, component] :
+             registry->view<WaylandApp::Component>().each()) {
+          if (component.app) {
+            component.app->getLatency().resetSamples();
+          }
+        }
+      }
+      ApiRequestResponse response;
+      response.set_requestid(batchedRequest.id);
+      response.set_success(registry != nullptr);
+      fulfillPendingResponse(batchedRequest.id, response);
+      break;
+    }
     default:
       break;
   }
@@ -961,10 +1081,17 @@ Api::mutateEntities()
   double target = time + 0.005;
   grabBatched();
   auto batchedRequests = getBatchedRequests();
+  if (!batchedRequests->empty()) {
+    sceneDamage::mark();
+  }
   for (; time <= target && batchedRequests->size() != 0; time = nowSeconds()) {
     processBatchedRequest(batchedRequests->front());
     batchedRequests->pop();
   }
+  // whatever didn't fit in the budget needs another iteration
+  if (!batchedRequests->empty()) {
+    sceneDamage::wake();
+  }
   releaseBatched();
   updateCachedStatus();
 }
@@ -0,0 +1,71 @@
+#include "appVisibility.h"
+#include <algorithm>
+#include <cmath>
+
+float
+projectedAppArea(const glm::mat4& viewProjection,
+                 const glm::mat4& localToWorld,
+                 float halfWidth,
+                 float halfHeight,
+                 float viewportWidth,
+                 float viewportHeight)
+{
+  const glm::mat4 toClip = viewProjection * localToWorld;
+  const glm::vec4 clip[4] = {
+    toClip * glm::vec4(-halfWidth, -halfHeight, 0.0f, 1.0f),
+    toClip * glm::vec4(halfWidth, -halfHeight, 0.0f, 1.0f),
+    toClip * glm::vec4(halfWidth, halfHeight, 0.0f, 1.0f),
+    toClip * glm::vec4(-halfWidth, halfHeight, 0.0f, 1.0f),
+  };
+
+  // outside when every corner is beyond the same clip plane
+  for (int axis = 0; axis < 3; axis++) {
+    bool allBelow = true;
+    bool allAbove = true;
+    for (const auto& corner : clip) {
+      allBelow = allBelow && corner[axis] < -corner.w;
+      allAbove = allAbove && corner[axis] > corner.w;
+    }
+    if (allBelow || allAbove) {
+      return 0.0f;
+    }
+  }
+
+  glm::vec2 low(1.0f);
+  glm::vec2 high(-1.0f);
+  for (const auto& corner : clip) {
+    // corners behind the eye don't project to anything meaningful
+    if (corner.w <= 0.0f) {
+      return viewportWidth * viewportHeight;
+    }
+    glm::vec2 ndc = glm::clamp(glm::vec2(corner) / corner.w, -1.0f, 1.0f);
+    low = glm::min(low, ndc);
+    high = glm::max(high, ndc);
+  }
+  glm::vec2 extent = glm::max(high - low, glm::vec2(0.0f));
+  return extent.x * extent.y * viewportWidth * viewportHeight / 4.0f;
+}
+
+int
+resolutionLodLevel(int currentLevel,
+                   float projectedPixels,
+                   int fullWidth,
+                   int fullHeight)
+{
+  if (fullWidth <= 0 || fullHeight <= 0) {
+    return 0;
+  }
+  // screen pixels per full-size buffer pixel, along one axis
+  float coverage =
+    std::sqrt(projectedPixels / (float(fullWidth) * float(fullHeight)));
+  int level = std::clamp(currentLevel, 0, kMaxResolutionLod);
+  while (level > 0 && coverage > std::ldexp(1.0f, -level)) {
+    level--;
+  }
+  while (level < kMaxResolutionLod &&
+         coverage < std::ldexp(kResolutionLodHysteresis, -(level + 1)) &&
+         std::min(fullWidth, fullHeight) >> (level + 1) >= kMinLodDimension) {
+    level++;
+  }
+  return level;
+}
@@ -1,71 +1,39 @@
 #include "components/Light.h"
 #include "glad/glad.h"
+#include "shadowAtlas.h"
 #include "glm/gtc/matrix_transform.hpp"
 #include <sstream>
 #include <iostream>
 #include "stb/stb_image_write.h"
+#include "time_utils.h"
 #include "tracy/TracyOpenGL.hpp"
 
-unsigned int Light::nextTextureUnit = 20;
-
 Light::Light(glm::vec3 color): color(color) {
-  textureUnit = nextTextureUnit++;
-  std::cout << "textureUnit: " << textureUnit << std::endl;
   farPlane = 50.0f;
   nearPlane = 0.02f;
-
-  glGenFramebuffers(1, &depthMapFBO);
-  glGenTextures(1, &depthCubemap);
-  glActiveTexture(GL_TEXTURE0 + textureUnit);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-
-  // Allocate storage for each face of the depth cubemap
-  for (unsigned int i = 0; i < 6; ++i) {
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
-        GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT,
-        0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL); 
-  }
-
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-  GLint prevFbo = 0;
-  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-
-  glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-
-  glDrawBuffer(GL_NONE);
-  glReadBuffer(GL_NONE);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
 }
 
-void Light::renderDepthMap(glm::vec3 lightPos, std::function<void()> renderScene) {
-  int viewport[4];
-  glGetIntegerv(GL_VIEWPORT, viewport);
-  int SCR_WIDTH = viewport[2];
-  int SCR_HEIGHT = viewport[3];
+void Light::renderDepthMap(ShadowAtlas& atlas,
+                           glm::vec3 lightPos,
+                           std::function<void(int face)> renderFace) {
   lightspaceTransform(lightPos);
-  glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-  GLint prevFbo = 0;
-  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-  glClear(GL_DEPTH_BUFFER_BIT);
   TracyGpuZone("renderDepthMap");
-  renderScene();
-  glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
-  glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+  atlas.render(shadowSlot, shadowResolution, renderFace);
+  shadowDirty = false;
+  shadowMapped = true;
+  mappedResolution = shadowResolution;
+}
+
+void Light::invalidateShadow() {
+  if (!shadowDirty) {
+    shadowDirty = true;
+    dirtySince = nowSeconds();
+  }
 }
 
 void Light::lightspaceTransform(glm::vec3 lightPos) {
-  std::cout << "lightspace transform: " << lightPos.x << "," << lightPos.y << ", " << lightPos.z << std::endl;
-  float aspect = (float)SHADOW_WIDTH/(float)SHADOW_HEIGHT;
   glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f),
-      aspect, nearPlane, farPlane);
+      1.0f, nearPlane, farPlane);
   shadowTransforms.clear();
   shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
   shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
@@ -0,0 +1,253 @@
+#include "cookedModel.h"
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static_assert(is_trivially_copyable_v<Vertex>);
+static_assert(sizeof(Vertex) % 4 == 0);
+static_assert(sizeof(unsigned int) == sizeof(uint32_t));
+
+namespace {
+
+const char MAGIC[4] = { 'H', 'M', 'C', 'M' };
+// bump whenever the layout, Vertex or the import flags change
+const uint32_t VERSION = 1;
+
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t meshCount;
+  float center[3];
+  float radius;
+};
+
+struct MeshHeader
+{
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t textureCount;
+};
+
+// read-only view of a whole file
+class MappedFile
+{
+public:
+  MappedFile(const string& path)
+  {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void* mapped =
+        mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        bytes = static_cast<const char*>(mapped);
+        size = info.st_size;
+      }
+    }
+    close(fd);
+  }
+  ~MappedFile()
+  {
+    if (bytes) {
+      munmap(const_cast<char*>(bytes), size);
+    }
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* bytes = nullptr;
+  size_t size = 0;
+};
+
+// bounds-checked cursor over a mapped file
+struct Reader
+{
+  const char* at;
+  const char* end;
+
+  bool take(void* out, size_t length)
+  {
+    if (size_t(end - at) < length) {
+      return false;
+    }
+    memcpy(out, at, length);
+    at += length;
+    return true;
+  }
+
+  bool skipPadding()
+  {
+    size_t pad = (4 - (reinterpret_cast<uintptr_t>(at) & 3)) & 3;
+    if (size_t(end - at) < pad) {
+      return false;
+    }
+    at += pad;
+    return true;
+  }
+
+  template<typename T>
+  bool takeArray(vector<T>& out, uint32_t count)
+  {
+    if (size_t(end - at) / sizeof(T) < count) {
+      return false;
+    }
+    out.resize(count);
+    return take(out.data(), count * sizeof(T));
+  }
+};
+
+void
+writePadding(ostream& out)
+{
+  static const char zeros[4] = {};
+  auto pad = (4 - (size_t(out.tellp()) & 3)) & 3;
+  out.write(zeros, pad);
+}
+
+}
+
+optional<uint64_t>
+hashModelFile(const string& path)
+{
+  MappedFile file(path);
+  if (!file.bytes) {
+    return nullopt;
+  }
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < file.size; i++) {
+    hash ^= uint8_t(file.bytes[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+string
+cookedModelPath(const string& cacheDir, uint64_t hash)
+{
+  stringstream name;
+  name << hex << hash << ".hmc";
+  return (fs::path(cacheDir) / name.str()).string();
+}
+
+bool
+readCookedModel(const string& path,
+                vector<MeshData>& meshes,
+                BoundingSphere& bounds)
+{
+  MappedFile file(path);
+  if (!file.bytes) {
+    return false;
+  }
+  Reader reader{ file.bytes, file.bytes + file.size };
+  Header header;
+  if (!reader.take(&header, sizeof(header)) ||
+      memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION) {
+    return false;
+  }
+  if (size_t(reader.end - reader.at) / sizeof(MeshHeader) < header.meshCount) {
+    return false;
+  }
+
+  vector<MeshData> read(header.meshCount);
+  for (auto& mesh : read) {
+    MeshHeader counts;
+    if (!reader.take(&counts, sizeof(counts)) ||
+        !reader.takeArray(mesh.vertices, counts.vertexCount) ||
+        !reader.takeArray(mesh.indices, counts.indexCount)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < counts.textureCount; i++) {
+      uint32_t lengths[2];
+      if (!reader.take(lengths, sizeof(lengths)) ||
+          size_t(reader.end - reader.at) < size_t(lengths[0]) + lengths[1]) {
+        return false;
+      }
+      string type(reader.at, lengths[0]);
+      string texturePath(reader.at + lengths[0], lengths[1]);
+      reader.at += lengths[0] + lengths[1];
+      if (!reader.skipPadding()) {
+        return false;
+      }
+      mesh.textures.push_back({ std::move(type), std::move(texturePath) });
+    }
+  }
+
+  meshes = std::move(read);
+  bounds = BoundingSphere{
+    glm::vec3(header.center[0], header.center[1], header.center[2]),
+    header.radius
+  };
+  return true;
+}
+
+bool
+writeCookedModel(const string& path,
+                 const vector<MeshData>& meshes,
+                 const BoundingSphere& bounds)
+{
+  std::error_code ec;
+  fs::create_directories(fs::path(path).parent_path(), ec);
+  // unique per writer, in case two models share contents
+  string temporary =
+    path + ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+  {
+    ofstream out(temporary, ios::binary | ios::trunc);
+    if (!out) {
+      return false;
+    }
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.meshCount = meshes.size();
+    header.center[0] = bounds.center.x;
+    header.center[1] = bounds.center.y;
+    header.center[2] = bounds.center.z;
+    header.radius = bounds.radius;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (auto& mesh : meshes) {
+      MeshHeader counts{ uint32_t(mesh.vertices.size()),
+                         uint32_t(mesh.indices.size()),
+                         uint32_t(mesh.textures.size()) };
+      out.write(reinterpret_cast<const char*>(&counts), sizeof(counts));
+      out.write(reinterpret_cast<const char*>(mesh.vertices.data()),
+                mesh.vertices.size() * sizeof(Vertex));
+      out.write(reinterpret_cast<const char*>(mesh.indices.data()),
+                mesh.indices.size() * sizeof(unsigned int));
+      for (auto& [type, texturePath] : mesh.textures) {
+        uint32_t lengths[2] = { uint32_t(type.size()),
+                                uint32_t(texturePath.size()) };
+        out.write(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+        out << type << texturePath;
+        writePadding(out);
+      }
+    }
+    if (!out) {
+      out.close();
+      fs::remove(temporary, ec);
+      return false;
+    }
+  }
+  fs::rename(temporary, path, ec);
+  if (ec) {
+    fs::remove(temporary, ec);
+    return false;
+  }
+  return true;
+}
@@ -6,20 +6,27 @@
 #pragma GCC diagnostic pop
 
 #include "engine.h"
+#include "Config.h"
 #include "components/Bootable.h"
 #include "components/Key.h"
 #include "components/Lock.h"
 #include "components/Parent.h"
 #include "components/Scriptable.h"
 #include "components/Light.h"
+#include "components/RotateMovement.h"
+#include "components/SimulatedTransform.h"
+#include "components/TranslateMovement.h"
 #include "entity.h"
 #include "logger.h"
 #include "model.h"
 #include "persister.h"
+#include "sceneDamage.h"
 #include "TypedKeyOverlay.h"
 #include "systems/Boot.h"
 #include "systems/Derivative.h"
 #include "systems/Light.h"
+#include "systems/ModelLoading.h"
+#include "systems/Update.h"
 #include "WindowManager/WindowManager.h"
 #include "blocks.h"
 #include "systems/Door.h"
@@ -53,6 +60,7 @@ void
 Engine::setupRegistry()
 {
   registry = make_shared<EntityRegistry>();
+  systems::trackDamage(registry);
 
   // Create all the Persistor
   // declaritively, because C++ type system can't 
@@ -110,6 +118,20 @@ Engine::Engine(char** envp, EngineOptions options)
   , options(options)
   , frameTimes(20, 0.0)
 {
+  try {
+    modelUploadBudget =
+      Config::singleton()->get<float>("model_upload_budget_ms") / 1000.0;
+  } catch (...) {
+  }
+  try {
+    ModelAssets::setCacheDirectory(
+      Config::singleton()->get<std::string>("model_cache_dir"));
+  } catch (...) {
+  }
+  try {
+    minFrameRate = Config::singleton()->get<float>("min_frame_rate");
+  } catch (...) {
+  }
   setupRegistry();
 
   // this probably doesn't belong here
@@ -205,15 +227,60 @@ void Engine::multiplayerClientIteration(double frameStart) {
 }
 
 void
-Engine::frame()
+Engine::markSceneChanges(double now)
+{
+  bool cameraMoved = camera->isMoving() ||
+                     camera->position != renderedCameraPosition ||
+                     camera->front != renderedCameraFront;
+  bool animating = !registry->view<TranslateMovement>().empty() ||
+                   !registry->view<RotateMovement>().empty() ||
+                   !registry->view<SimulatedTransform>().empty();
+  bool overdue =
+    minFrameRate > 0 && now - lastRenderTime >= 1.0 / minFrameRate;
+  if (cameraMoved || animating || overdue || client || server ||
+      renderer->shadersChanged() || renderer->captureRequested()) {
+    sceneDamage::mark();
+  }
+}
+
+double
+Engine::idleTimeout()
+{
+  if (ModelAssets::pending() > 0 || renderer->capturesInFlight()) {
+    // keep finishing loads and readbacks at roughly display rate
+    return 1.0 / 60.0;
+  }
+  if (minFrameRate <= 0) {
+    return -1;
+  }
+  double remaining =
+    lastRenderTime + 1.0 / minFrameRate - currentTimeSeconds();
+  return std::max(remaining, 0.0);
+}
+
+bool
+Engine::frame(bool drawScene)
 {
   double frameStart = currentTimeSeconds();
   api->mutateEntities();
+  systems::finishModelLoads(registry, modelUploadBudget);
+  renderer->pollCaptures();
   controls->pollPressedKeys();
-  renderer->render();
+  markSceneChanges(frameStart);
+  bool rendered = sceneDamage::consume();
+  if (rendered) {
+    if (drawScene) {
+      renderer->render();
+    }
+    renderedCameraPosition = camera->position;
+    renderedCameraFront = camera->front;
+    lastRenderTime = frameStart;
+  }
   world->tick();
   controls->poll();
   multiplayerClientIteration(frameStart);
+  // the simulation or input may have moved something after the render
+  markSceneChanges(frameStart);
 
   // Save state ImGui might clobber on GLES2 (primitive restart/poly mode).
   GLint prevProgram = 0;
@@ -234,6 +301,10 @@ Engine::frame()
   //glBindBuffer(GL_ARRAY_BUFFER, prevArray);
   //glBindTexture(GL_TEXTURE_2D, prevTexture);
 
+  if (!rendered) {
+    return false;
+  }
+
   TracyGpuCollect;
   FrameMark;
 
@@ -249,6 +320,7 @@ Engine::frame()
       fps = 1.0 / fps;
     }
   }
+  return true;
 }
 
 void
@@ -584,15 +584,19 @@ EngineGui::renderComponentPanel(entt::entity entity)
     auto& parent = registry->get<Parent>(entity);
     ImGui::Text("Parent Component:");
     for (int i = 0; i < parent.childrenIds.size(); i++) {
-      ImGui::InputInt(
-        ("Child Id##" + to_string(i) + to_string((int)entity)).c_str(),
-        &parent.childrenIds[i]);
+      if (ImGui::InputInt(
+            ("Child Id##" + to_string(i) + to_string((int)entity)).c_str(),
+            &parent.childrenIds[i])) {
+        registry->patch<Parent>(entity);
+      }
     }
     if (ImGui::Button(("- Remove Child##" + to_string((int)entity)).c_str())) {
       parent.childrenIds.pop_back();
+      registry->patch<Parent>(entity);
     }
     if (ImGui::Button(("+ Add Child##" + to_string((int)entity)).c_str())) {
       parent.childrenIds.push_back(0);
+      registry->patch<Parent>(entity);
     }
     if (ImGui::Button(
           ("Delete Component##Parent" + to_string((int)entity)).c_str())) {
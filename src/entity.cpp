@@ -99,6 +99,12 @@ EntityRegistry::depersist(entt::entity entity)
   destroy(entity);
 }
 
+std::vector<entt::entity>&
+EntityRegistry::damageQueue()
+{
+  return damagedPositionables;
+}
+
 std::optional<entt::entity>
 EntityRegistry::locateEntity(int entityIdForDB)
 {
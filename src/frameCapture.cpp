@@ -0,0 +1,179 @@
+#include "frameCapture.h"
+#include "stb/stb_image_write.h"
+#include "wayland/pixelConvert.h"
+#include <cstring>
+#include <drm_fourcc.h>
+
+namespace {
+
+GLenum
+readFormat()
+{
+#ifdef GL_BGRA
+  return GL_BGRA;
+#elif defined(GL_BGRA_EXT)
+  return GL_BGRA_EXT;
+#else
+  return GL_RGBA;
+#endif
+}
+
+void
+convert(const uint8_t* pixels,
+        int width,
+        int height,
+        GLenum format,
+        const std::vector<FrameCapture::Callback>& callbacks)
+{
+  FrameCapture::Frame frame;
+  frame.width = width;
+  frame.height = height;
+  frame.rgba.resize(size_t(width) * height * 4);
+  if (format == GL_RGBA) {
+    std::memcpy(frame.rgba.data(), pixels, frame.rgba.size());
+  } else {
+    // BGRA bytes are the little-endian layout of ARGB8888
+    RowConverter toRgba = rowConverterFor(DRM_FORMAT_ARGB8888);
+    toRgba(pixels, frame.rgba.data(), width * height);
+  }
+  for (auto& callback : callbacks) {
+    callback(frame);
+  }
+}
+
+bool
+asyncSupported()
+{
+  return glFenceSync != nullptr && glMapBufferRange != nullptr;
+}
+
+}
+
+FrameCapture::~FrameCapture()
+{
+  // the callbacks may outlive the GL objects, which go with the context
+  for (auto& readback : readbacks) {
+    if (readback.worker.valid()) {
+      readback.worker.wait();
+    }
+  }
+}
+
+void
+FrameCapture::read(int width, int height, std::vector<Callback> callbacks)
+{
+  if (width <= 0 || height <= 0 || callbacks.empty()) {
+    return;
+  }
+  GLenum format = readFormat();
+  size_t bytes = size_t(width) * height * 4;
+  GLint prevPack = 0;
+  glGetIntegerv(GL_PACK_ALIGNMENT, &prevPack);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  if (!asyncSupported()) {
+    std::vector<uint8_t> pixels(bytes);
+    glReadPixels(0, 0, width, height, format, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, prevPack);
+    Readback readback;
+    readback.worker = std::async(
+      std::launch::async,
+      [pixels = std::move(pixels), width, height, format, callbacks]() {
+        convert(pixels.data(), width, height, format, callbacks);
+      });
+    readbacks.push_back(std::move(readback));
+    return;
+  }
+
+  Readback readback;
+  if (!spare.empty()) {
+    readback = std::move(spare.back());
+    spare.pop_back();
+  } else {
+    glGenBuffers(1, &readback.buffer);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+  if (readback.capacity < bytes) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    readback.capacity = bytes;
+  }
+  // with a pack buffer bound the pointer is an offset into it
+  glReadPixels(0, 0, width, height, format, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, prevPack);
+  readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  readback.width = width;
+  readback.height = height;
+  readback.format = format;
+  readback.callbacks = std::move(callbacks);
+  readbacks.push_back(std::move(readback));
+}
+
+void
+FrameCapture::poll()
+{
+  for (size_t i = 0; i < readbacks.size();) {
+    Readback& readback = readbacks[i];
+    if (!readback.worker.valid()) {
+      GLenum state = glClientWaitSync(readback.fence, 0, 0);
+      if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED) {
+        i++;
+        continue;
+      }
+      glDeleteSync(readback.fence);
+      readback.fence = nullptr;
+      size_t bytes = size_t(readback.width) * readback.height * 4;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+      auto* pixels = static_cast<const uint8_t*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      if (pixels == nullptr) {
+        spare.push_back(std::move(readback));
+        readbacks.erase(readbacks.begin() + i);
+        continue;
+      }
+      // the mapping stays valid until unmapped below, once the worker is done
+      readback.worker = std::async(std::launch::async,
+                                   [pixels,
+                                    width = readback.width,
+                                    height = readback.height,
+                                    format = readback.format,
+                                    callbacks = std::move(readback.callbacks)]() {
+                                     convert(pixels, width, height, format, callbacks);
+                                   });
+    }
+    if (readback.worker.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      i++;
+      continue;
+    }
+    readback.worker = {};
+    if (readback.buffer != 0) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      readback.callbacks.clear();
+      spare.push_back(std::move(readback));
+    }
+    readbacks.erase(readbacks.begin() + i);
+  }
+}
+
+std::vector<uint8_t>
+encodePng(const FrameCapture::Frame& frame)
+{
+  std::vector<uint8_t> png;
+  stbi_write_png_to_func(
+    [](void* context, void* data, int size) {
+      auto* out = static_cast<std::vector<uint8_t>*>(context);
+      auto* bytes = static_cast<uint8_t*>(data);
+      out->insert(out->end(), bytes, bytes + size);
+    },
+    &png,
+    frame.width,
+    frame.height,
+    4,
+    frame.rgba.data(),
+    frame.width * 4);
+  return png;
+}
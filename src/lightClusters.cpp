@@ -0,0 +1,212 @@
+#include "lightClusters.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+void
+LightSpheres::clear()
+{
+  for (auto* column : { &x, &y, &z, &radius }) {
+    column->clear();
+  }
+}
+
+void
+LightSpheres::push(glm::vec3 center, float r)
+{
+  x.push_back(center.x);
+  y.push_back(center.y);
+  z.push_back(center.z);
+  radius.push_back(r);
+}
+
+size_t
+LightSpheres::size() const
+{
+  return x.size();
+}
+
+namespace {
+
+#if defined(__AVX__)
+typedef __m256 Lanes;
+constexpr size_t LANES = 8;
+inline Lanes load(const float* p) { return _mm256_loadu_ps(p); }
+inline Lanes splat(float v) { return _mm256_set1_ps(v); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+inline unsigned lessEqualMask(Lanes a, Lanes b)
+{
+  return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ));
+}
+#elif defined(__SSE2__)
+typedef __m128 Lanes;
+constexpr size_t LANES = 4;
+inline Lanes load(const float* p) { return _mm_loadu_ps(p); }
+inline Lanes splat(float v) { return _mm_set1_ps(v); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+inline unsigned lessEqualMask(Lanes a, Lanes b)
+{
+  return _mm_movemask_ps(_mm_cmple_ps(a, b));
+}
+#else
+constexpr size_t LANES = 1;
+#endif
+
+// squared distance from a point to [lo, hi] along one axis
+inline float
+axisGap(float v, float lo, float hi)
+{
+  float gap = std::max(std::max(lo - v, v - hi), 0.0f);
+  return gap * gap;
+}
+
+}
+
+LightClusters::LightClusters(int tilesX, int tilesY, int slices)
+  : tilesX(tilesX)
+  , tilesY(tilesY)
+  , slices(slices)
+{
+  size_t count = clusterCount();
+  for (auto* column : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+    column->resize(count);
+  }
+  ranges.resize(count * 2);
+}
+
+void
+LightClusters::setProjection(const glm::mat4& projection, float near, float far)
+{
+  float logRatio = log(far / near);
+  depthScale = slices / logRatio;
+  depthBias = -slices * log(near) / logRatio;
+
+  glm::mat4 inverse = glm::inverse(projection);
+  // view-space direction through an NDC point, scaled to unit depth
+  auto ray = [&](float ndcX, float ndcY) {
+    glm::vec4 p = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec3 v = glm::vec3(p) / p.w;
+    return v / -v.z;
+  };
+
+  for (int z = 0; z < slices; z++) {
+    float sliceNear = near * pow(far / near, float(z) / slices);
+    float sliceFar = near * pow(far / near, float(z + 1) / slices);
+    for (int y = 0; y < tilesY; y++) {
+      for (int x = 0; x < tilesX; x++) {
+        float x0 = -1.0f + 2.0f * x / tilesX;
+        float x1 = -1.0f + 2.0f * (x + 1) / tilesX;
+        float y0 = -1.0f + 2.0f * y / tilesY;
+        float y1 = -1.0f + 2.0f * (y + 1) / tilesY;
+        glm::vec3 lo(numeric_limits<float>::max());
+        glm::vec3 hi(-numeric_limits<float>::max());
+        for (auto corner : { ray(x0, y0), ray(x1, y0), ray(x0, y1), ray(x1, y1) }) {
+          for (float depth : { sliceNear, sliceFar }) {
+            lo = glm::min(lo, corner * depth);
+            hi = glm::max(hi, corner * depth);
+          }
+        }
+        size_t c = x + y * tilesX + z * tilesX * tilesY;
+        minX[c] = lo.x;
+        minY[c] = lo.y;
+        minZ[c] = lo.z;
+        maxX[c] = hi.x;
+        maxY[c] = hi.y;
+        maxZ[c] = hi.z;
+      }
+    }
+  }
+}
+
+void
+LightClusters::assign(const LightSpheres& lights)
+{
+  lightIndices.clear();
+  size_t tiles = size_t(tilesX) * tilesY;
+  for (int z = 0; z < slices; z++) {
+    // every cluster of a slice shares its depth range, so lights that miss
+    // the slab are dropped once here instead of once per tile
+    size_t first = z * tiles;
+    float slabNear = maxZ[first], slabFar = minZ[first];
+    for (size_t c = first; c < first + tiles; c++) {
+      slabNear = std::max(slabNear, maxZ[c]);
+      slabFar = std::min(slabFar, minZ[c]);
+    }
+    sliceLights.clear();
+    sliceIndices.clear();
+    for (size_t i = 0; i < lights.size(); i++) {
+      if (lights.z[i] - lights.radius[i] <= slabNear &&
+          lights.z[i] + lights.radius[i] >= slabFar) {
+        sliceLights.push(
+          glm::vec3(lights.x[i], lights.y[i], lights.z[i]), lights.radius[i]);
+        sliceIndices.push_back(i);
+      }
+    }
+    size_t count = sliceLights.size();
+    // pad to whole lanes with lights that can't reach anything
+    while (sliceLights.size() % LANES != 0) {
+      sliceLights.push(glm::vec3(numeric_limits<float>::max()), 0.0f);
+    }
+
+    for (size_t c = first; c < first + tiles; c++) {
+      uint32_t offset = lightIndices.size();
+      size_t i = 0;
+#if defined(__AVX__) || defined(__SSE2__)
+      Lanes zero = splat(0.0f);
+      Lanes loX = splat(minX[c]), hiX = splat(maxX[c]);
+      Lanes loY = splat(minY[c]), hiY = splat(maxY[c]);
+      Lanes loZ = splat(minZ[c]), hiZ = splat(maxZ[c]);
+      for (; i < count; i += LANES) {
+        Lanes x = load(&sliceLights.x[i]);
+        Lanes y = load(&sliceLights.y[i]);
+        Lanes z = load(&sliceLights.z[i]);
+        Lanes r = load(&sliceLights.radius[i]);
+        Lanes gx = max(max(sub(loX, x), sub(x, hiX)), zero);
+        Lanes gy = max(max(sub(loY, y), sub(y, hiY)), zero);
+        Lanes gz = max(max(sub(loZ, z), sub(z, hiZ)), zero);
+        Lanes distance = add(add(mul(gx, gx), mul(gy, gy)), mul(gz, gz));
+        unsigned hits = lessEqualMask(distance, mul(r, r));
+        while (hits != 0) {
+          int lane = __builtin_ctz(hits);
+          hits &= hits - 1;
+          lightIndices.push_back(sliceIndices[i + lane]);
+        }
+      }
+#endif
+      for (; i < count; i++) {
+        float distance =
+          axisGap(sliceLights.x[i], minX[c], maxX[c]) +
+          axisGap(sliceLights.y[i], minY[c], maxY[c]) +
+          axisGap(sliceLights.z[i], minZ[c], maxZ[c]);
+        float r = sliceLights.radius[i];
+        if (distance <= r * r) {
+          lightIndices.push_back(sliceIndices[i]);
+        }
+      }
+      ranges[c * 2] = offset;
+      ranges[c * 2 + 1] = lightIndices.size() - offset;
+    }
+  }
+}
+
+int
+LightClusters::clusterAt(glm::vec2 ndc, float viewDepth) const
+{
+  int x = std::clamp(int((ndc.x + 1.0f) * 0.5f * tilesX), 0, tilesX - 1);
+  int y = std::clamp(int((ndc.y + 1.0f) * 0.5f * tilesY), 0, tilesY - 1);
+  int z = std::clamp(
+    int(floor(log(viewDepth) * depthScale + depthBias)), 0, slices - 1);
+  return x + y * tilesX + z * tilesX * tilesY;
+}
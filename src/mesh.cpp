@@ -11,6 +11,19 @@ Mesh::Mesh(vector<Vertex> vertices,
   this->indices = indices;
   this->textures = textures;
 
+  unsigned int diffuseNr = 1;
+  unsigned int specularNr = 1;
+  for (auto& texture : this->textures) {
+    // retrieve texture number (the N in diffuse_textureN)
+    string number;
+    string name = texture.type;
+    if (name == "texture_diffuse")
+      number = std::to_string(diffuseNr++);
+    else if (name == "texture_specular")
+      number = std::to_string(specularNr++);
+    textureUniforms.push_back(Uniform(name + number));
+  }
+
   setupMesh();
 }
 
@@ -57,29 +70,56 @@ Mesh::setupMesh()
 }
 
 void
-Mesh::Draw(Shader& shader)
+Mesh::release()
 {
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  VAO = VBO = EBO = 0;
+}
 
-  unsigned int diffuseNr = 1;
-  unsigned int specularNr = 1;
-  for (unsigned int i = 0; i < textures.size(); i++) {
-    glActiveTexture(GL_TEXTURE1 +
-                    i); // activate proper texture unit before binding
-    // retrieve texture number (the N in diffuse_textureN)
-    string number;
-    string name = textures[i].type;
-    if (name == "texture_diffuse")
-      number = std::to_string(diffuseNr++);
-    else if (name == "texture_specular")
-      number = std::to_string(specularNr++);
-
-    shader.setInt((name + number).c_str(), i + 1);
-    glBindTexture(GL_TEXTURE_2D, textures[i].id);
-  }
-  glActiveTexture(GL_TEXTURE0);
-
-  // draw mesh
+void
+Mesh::attachInstanceBuffer(unsigned int buffer)
+{
   glBindVertexArray(VAO);
-  glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  for (int column = 0; column < 4; column++) {
+    glEnableVertexAttribArray(3 + column);
+    glVertexAttribPointer(
+      3 + column,
+      4,
+      GL_FLOAT,
+      GL_FALSE,
+      sizeof(ModelInstance),
+      (void*)(offsetof(ModelInstance, model) + column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(3 + column, 1);
+  }
+  for (int column = 0; column < 3; column++) {
+    glEnableVertexAttribArray(9 + column);
+    glVertexAttribPointer(9 + column,
+                          3,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(ModelInstance),
+                          (void*)(offsetof(ModelInstance, normalMatrix) +
+                                  column * sizeof(glm::vec3)));
+    glVertexAttribDivisor(9 + column, 1);
+  }
   glBindVertexArray(0);
 }
+
+void
+Mesh::submit(RenderQueue& queue, GLuint program, DrawItem item)
+{
+  // the first texture stands in for the material; meshes sharing it share
+  // every binding the queue has to make
+  GLuint material = textures.empty() ? 0 : textures[0].id;
+  item.key = RenderQueue::makeKey(item.pass, program, material, VAO);
+  item.vertexArray = VAO;
+  item.mode = GL_TRIANGLES;
+  item.count = indices.size();
+  item.indexed = true;
+  item.textures = &textures;
+  item.textureUniforms = &textureUniforms;
+  queue.submit(item);
+}
@@ -3,13 +3,20 @@
 #include <assimp/material.h>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <filesystem>
+#include <future>
 #include <iostream>
 #include <sstream>
+#include <utility>
 #include "components/BoundingSphere.h"
+#include "cookedModel.h"
 #include "glm/trigonometric.hpp"
 #include "persister.h"
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
+#include "time_utils.h"
+#include "tracy/Tracy.hpp"
+#include "transformBatch.h"
 
 #include "glm/ext/matrix_transform.hpp"
 #include <glm/gtc/quaternion.hpp>
@@ -17,49 +24,115 @@
 using namespace std;
 
 void
-Model::Draw(Shader& shader)
+ModelAsset::submit(RenderQueue& queue, GLuint program, const DrawItem& item)
 {
-  for (unsigned int i = 0; i < meshes.size(); i++)
-    meshes[i].Draw(shader);
-}
-
-void
-Model::loadModel(string path)
-{
-  Assimp::Importer import;
-  const aiScene* scene =
-    import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-      !scene->mRootNode) {
-    cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
+  if (!ready) {
     return;
   }
-  directory = path.substr(0, path.find_last_of('/'));
-
-  processNode(scene->mRootNode, scene);
+  for (unsigned int i = 0; i < meshes.size(); i++)
+    meshes[i].submit(queue, program, item);
 }
 
-void
-Model::processNode(aiNode* node, const aiScene* scene)
+static void
+processMesh(aiMesh* mesh,
+            const aiScene* scene,
+            ModelAsset::ParsedModel& parsed);
+
+static void
+processNode(aiNode* node,
+            const aiScene* scene,
+            ModelAsset::ParsedModel& parsed)
 {
   // process all the node's meshes (if any)
   for (unsigned int i = 0; i < node->mNumMeshes; i++) {
     aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-    meshes.push_back(processMesh(mesh, scene));
+    processMesh(mesh, scene, parsed);
   }
   // then do the same for each of its children
   for (unsigned int i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene);
+    processNode(node->mChildren[i], scene, parsed);
   }
 }
 
-Mesh
-Model::processMesh(aiMesh* mesh, const aiScene* scene)
+static void
+loadMaterialTextures(aiMaterial* mat,
+                     aiTextureType type,
+                     string typeName,
+                     MeshData& mesh)
 {
-  vector<Vertex> vertices;
-  vector<unsigned int> indices;
-  vector<MeshTexture> textures;
+  for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
+    aiString str;
+    mat->GetTexture(type, i, &str);
+    mesh.textures.push_back({ typeName, str.C_Str() });
+  }
+}
+
+// decodes every image the meshes refer to, once each
+static void
+decodeImages(ModelAsset::ParsedModel& parsed)
+{
+  for (auto& mesh : parsed.meshes) {
+    for (auto& [type, path] : mesh.textures) {
+      bool decoded = false;
+      for (auto& image : parsed.images) {
+        if (image.path == path) {
+          decoded = true;
+          break;
+        }
+      }
+      if (decoded) {
+        continue;
+      }
+      ModelAsset::ImageData image;
+      image.path = path;
+      string filename = parsed.directory + '/' + path;
+      // flipping is per thread here, so this can't race the render thread
+      stbi_set_flip_vertically_on_load_thread(false);
+      image.pixels = stbi_load(
+        filename.c_str(), &image.width, &image.height, &image.channels, 0);
+      parsed.images.push_back(std::move(image));
+    }
+  }
+}
+
+static BoundingSphere
+boundsOf(const vector<MeshData>& meshes)
+{
+  // 1. Find bounding box:
+  glm::vec3 minBounds(std::numeric_limits<float>::max());
+  glm::vec3 maxBounds(-std::numeric_limits<float>::max());
+  bool empty = true;
+  for (auto& mesh : meshes) {
+    for (const Vertex& vertex : mesh.vertices) {
+      minBounds = glm::min(minBounds, vertex.Position);
+      maxBounds = glm::max(maxBounds, vertex.Position);
+      empty = false;
+    }
+  }
+  if (empty) {
+    return BoundingSphere{ glm::vec3(0.0f), 0.0f };
+  }
+
+  // 2. Calculate center:
+  glm::vec3 center = (minBounds + maxBounds) * 0.5f;
+
+  // 3. Find the radius:
+  float radius = 0.0f;
+  for (auto& mesh : meshes) {
+    for (const Vertex& vertex : mesh.vertices) {
+      radius = std::max(radius, glm::distance(vertex.Position, center));
+    }
+  }
+  return BoundingSphere{ center, radius };
+}
+
+static void
+processMesh(aiMesh* mesh, const aiScene* scene, ModelAsset::ParsedModel& parsed)
+{
+  MeshData data;
+  auto& vertices = data.vertices;
+  auto& indices = data.indices;
+  vertices.reserve(mesh->mNumVertices);
 
   for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
     Vertex vertex;
@@ -95,93 +168,119 @@ Model::processMesh(aiMesh* mesh, const aiScene* scene)
 
   if (mesh->mMaterialIndex >= 0) {
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    vector<MeshTexture> diffuseMaps =
-      loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-    vector<MeshTexture> specularMaps = loadMaterialTextures(
-      material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    loadMaterialTextures(
+      material, aiTextureType_DIFFUSE, "texture_diffuse", data);
+    loadMaterialTextures(
+      material, aiTextureType_SPECULAR, "texture_specular", data);
   }
 
-  return Mesh(vertices, indices, textures);
+  parsed.meshes.push_back(std::move(data));
 }
 
-vector<Vertex>
-Model::getAllVertices()
+unique_ptr<ModelAsset::ParsedModel>
+ModelAsset::parse(string path, string cacheDir)
 {
-  vector<Vertex> allVertices;
+  ZoneScoped;
+  auto parsed = make_unique<ParsedModel>();
+  parsed->directory = path.substr(0, path.find_last_of('/'));
+
+  string cooked;
+  if (!cacheDir.empty()) {
+    if (auto hash = hashModelFile(path)) {
+      cooked = cookedModelPath(cacheDir, *hash);
+      if (readCookedModel(cooked, parsed->meshes, parsed->bounds)) {
+        decodeImages(*parsed);
+        return parsed;
+      }
+    }
+  }
 
-  for (const Mesh& mesh : meshes) {
-    allVertices.insert(
-      allVertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+  Assimp::Importer import;
+  const aiScene* scene =
+    import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+      !scene->mRootNode) {
+    cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
+    parsed->failed = true;
+    return parsed;
   }
 
-  return allVertices;
+  processNode(scene->mRootNode, scene, *parsed);
+  parsed->bounds = boundsOf(parsed->meshes);
+  if (!cooked.empty() &&
+      !writeCookedModel(cooked, parsed->meshes, parsed->bounds)) {
+    cout << "failed to write cooked model " << cooked << endl;
+  }
+  decodeImages(*parsed);
+  return parsed;
 }
 
-vector<MeshTexture>
-Model::loadMaterialTextures(aiMaterial* mat,
-                            aiTextureType type,
-                            string typeName)
+ModelAsset::ImageData::~ImageData()
 {
-  vector<MeshTexture> textures;
-  cout << "loading material textures" << endl;
-  for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-    cout << "loading texture " << i << endl;
-    aiString str;
-    mat->GetTexture(type, i, &str);
-    bool skip = false;
-    for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-      if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-        textures.push_back(textures_loaded[j]);
-        skip = true;
-        break;
-      }
-    }
-    if (!skip) { // if texture hasn't been loaded already, load it
-      MeshTexture texture;
-      texture.id = TextureFromFile(str.C_Str(), directory);
-      texture.type = typeName;
-      texture.path = str.C_Str();
-      textures.push_back(texture);
-      textures_loaded.push_back(texture); // add to loaded textures
-    }
+  if (pixels) {
+    stbi_image_free(pixels);
   }
-  return textures;
 }
 
-BoundingSphere
-Model::getBoundingSphere(float scale)
+ModelAsset::ImageData::ImageData(ImageData&& other) noexcept
+  : path(std::move(other.path))
+  , width(other.width)
+  , height(other.height)
+  , channels(other.channels)
+  , pixels(std::exchange(other.pixels, nullptr))
 {
-  auto vertices = getAllVertices();
-
-  if (vertices.empty()) {
-    // Handle the case of an empty mesh
-    return BoundingSphere{ glm::vec3(0.0f), 0.0f };
-  }
-
-  // 1. Find bounding box (same as before):
-  glm::vec3 minBounds(std::numeric_limits<float>::max());
-  glm::vec3 maxBounds(-std::numeric_limits<float>::max());
-
-  for (const Vertex& vertex : vertices) {
-    glm::vec3 scaledPosition = vertex.Position * scale;
-    minBounds = glm::min(minBounds, scaledPosition);
-    maxBounds = glm::max(maxBounds, scaledPosition);
-  }
+}
 
-  // 2. Calculate center:
-  glm::vec3 center = (minBounds + maxBounds) * 0.5f;
+void
+ModelAsset::uploadInstances(const vector<ModelInstance>& instances)
+{
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  // orphan the previous contents so a draw still reading them doesn't stall
+  glBufferData(GL_ARRAY_BUFFER,
+               instances.size() * sizeof(ModelInstance),
+               instances.data(),
+               GL_STREAM_DRAW);
+}
 
-  // 3. Find the radius:
-  float radius = 0.0f;
-  for (const Vertex& vertex : vertices) {
-    glm::vec3 scaledPosition = vertex.Position * scale;
-    float distance = glm::distance(scaledPosition, center);
-    radius = std::max(radius, distance);
-  }
+BoundingSphere
+ModelAsset::getBoundingSphere(float scale) const
+{
+  return BoundingSphere{ bounds.center * scale, bounds.radius * scale };
+}
 
-  return BoundingSphere{ center, radius };
+static void
+uploadTexture(unsigned int textureID,
+              unsigned char* data,
+              int width,
+              int height,
+              int nrComponents)
+{
+  GLenum format;
+  if (nrComponents == 1)
+    format = GL_RED;
+  else if (nrComponents == 3)
+    format = GL_RGB;
+  else if (nrComponents == 4)
+    format = GL_RGBA;
+
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               format,
+               width,
+               height,
+               0,
+               format,
+               GL_UNSIGNED_BYTE,
+               data);
+  glGenerateMipmap(GL_TEXTURE_2D);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(
+    GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
 unsigned int
@@ -199,32 +298,7 @@ TextureFromFile(const char* path, const string& directory, bool gamma)
     stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
   stbi_set_flip_vertically_on_load(true);
   if (data) {
-    GLenum format;
-    if (nrComponents == 1)
-      format = GL_RED;
-    else if (nrComponents == 3)
-      format = GL_RGB;
-    else if (nrComponents == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 format,
-                 width,
-                 height,
-                 0,
-                 format,
-                 GL_UNSIGNED_BYTE,
-                 data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(
-      GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
+    uploadTexture(textureID, data, width, height, nrComponents);
     stbi_image_free(data);
   } else {
     std::cout << "Texture failed to load at path: " << path << std::endl;
@@ -234,27 +308,241 @@ TextureFromFile(const char* path, const string& directory, bool gamma)
   return textureID;
 }
 
+ModelAsset::ModelAsset(string path)
+  : parsing(std::async(std::launch::async,
+                       &ModelAsset::parse,
+                       path,
+                       ModelAssets::cacheDirectory()))
+{
+}
+
+ModelAsset::~ModelAsset()
+{
+  if (parsing.valid()) {
+    // the worker owns nothing of ours, but its result must be collected
+    parsing.wait();
+  }
+  for (auto& mesh : meshes) {
+    mesh.release();
+  }
+  if (instanceBuffer != 0) {
+    glDeleteBuffers(1, &instanceBuffer);
+  }
+  for (auto& texture : textures_loaded) {
+    glDeleteTextures(1, &texture.id);
+  }
+}
+
+bool
+ModelAsset::parsed() const
+{
+  return !parsing.valid() || parsing.wait_for(std::chrono::seconds(0)) ==
+                               std::future_status::ready;
+}
+
+bool
+ModelAsset::uploadStep()
+{
+  if (ready) {
+    return true;
+  }
+  if (parsing.valid()) {
+    parsedModel = parsing.get();
+  }
+  auto& data = *parsedModel;
+  if (data.failed) {
+    finish(false);
+    return true;
+  }
+
+  // textures first, so meshes can refer to their ids
+  if (textures_loaded.size() < data.images.size()) {
+    auto& image = data.images[textures_loaded.size()];
+    MeshTexture texture;
+    glGenTextures(1, &texture.id);
+    texture.path = image.path;
+    if (image.pixels) {
+      uploadTexture(
+        texture.id, image.pixels, image.width, image.height, image.channels);
+    } else {
+      std::cout << "Texture failed to load at path: " << image.path
+                << std::endl;
+    }
+    textures_loaded.push_back(texture);
+    return false;
+  }
+
+  if (meshes.size() < data.meshes.size()) {
+    auto& mesh = data.meshes[meshes.size()];
+    vector<MeshTexture> textures;
+    for (auto& [type, path] : mesh.textures) {
+      for (auto& loaded : textures_loaded) {
+        if (loaded.path == path) {
+          MeshTexture texture = loaded;
+          texture.type = type;
+          textures.push_back(texture);
+          break;
+        }
+      }
+    }
+    meshes.push_back(Mesh(std::move(mesh.vertices),
+                          std::move(mesh.indices),
+                          std::move(textures)));
+    return false;
+  }
+
+  bounds = data.bounds;
+  glGenBuffers(1, &instanceBuffer);
+  for (auto& mesh : meshes) {
+    mesh.attachInstanceBuffer(instanceBuffer);
+  }
+  // non-instanced draws still fetch instance 0, so keep one valid entry
+  uploadInstances({ ModelInstance{ glm::mat4(1.0f), glm::mat3(1.0f) } });
+  finish(true);
+  return true;
+}
+
+void
+ModelAsset::finish(bool success)
+{
+  ready = success;
+  failed = !success;
+  parsedModel.reset();
+  for (auto& callback : readyCallbacks) {
+    callback(success);
+  }
+  readyCallbacks.clear();
+}
+
+void
+ModelAsset::whenReady(function<void(bool)> callback)
+{
+  if (ready || failed) {
+    callback(ready);
+    return;
+  }
+  readyCallbacks.push_back(std::move(callback));
+}
+
+string&
+ModelAssets::cacheDirectory()
+{
+  static string directory;
+  return directory;
+}
+
+void
+ModelAssets::setCacheDirectory(const string& directory)
+{
+  cacheDirectory() = directory;
+}
+
+unordered_map<string, weak_ptr<ModelAsset>>&
+ModelAssets::cache()
+{
+  static unordered_map<string, weak_ptr<ModelAsset>> assets;
+  return assets;
+}
+
+vector<shared_ptr<ModelAsset>>&
+ModelAssets::loading()
+{
+  static vector<shared_ptr<ModelAsset>> assets;
+  return assets;
+}
+
+shared_ptr<ModelAsset>
+ModelAssets::acquire(const string& path)
+{
+  std::error_code ec;
+  string key = fs::weakly_canonical(path, ec).string();
+  if (ec) {
+    key = path;
+  }
+  auto& assets = cache();
+  if (auto asset = assets[key].lock()) {
+    return asset;
+  }
+  // drop entries whose assets were evicted since the last load
+  std::erase_if(assets, [](auto& entry) { return entry.second.expired(); });
+  auto asset = make_shared<ModelAsset>(path);
+  assets[key] = asset;
+  loading().push_back(asset);
+  return asset;
+}
+
+vector<shared_ptr<ModelAsset>>
+ModelAssets::upload(double budgetSeconds)
+{
+  ZoneScoped;
+  vector<shared_ptr<ModelAsset>> finished;
+  auto& pending = loading();
+  double deadline = nowSeconds() + budgetSeconds;
+  // always make some progress, however small the budget
+  bool progressed = false;
+  for (auto it = pending.begin(); it != pending.end();) {
+    auto& asset = *it;
+    if (!asset->parsed()) {
+      ++it;
+      continue;
+    }
+    bool done = false;
+    while (!done && (!progressed || nowSeconds() < deadline)) {
+      done = asset->uploadStep();
+      progressed = true;
+    }
+    if (!done) {
+      break;
+    }
+    finished.push_back(asset);
+    it = pending.erase(it);
+  }
+  return finished;
+}
+
+size_t
+ModelAssets::pending()
+{
+  return loading().size();
+}
+
+size_t
+ModelAssets::size()
+{
+  size_t alive = 0;
+  for (auto& [path, asset] : cache()) {
+    alive += !asset.expired();
+  }
+  return alive;
+}
+
 Model::Model(string path)
   : path(path)
+  , asset(ModelAssets::acquire(path))
 {
-  loadModel(path);
 }
 
 void
-Positionable::update()
+Model::submit(RenderQueue& queue, GLuint program, const DrawItem& item)
 {
-  modelMatrix = glm::mat4(1.0f);
-  modelMatrix = glm::translate(modelMatrix, pos);
+  asset->submit(queue, program, item);
+}
 
-  // Create individual rotation quaternions
-  glm::quat finalRotation = glm::quat(glm::radians(rotate));
+BoundingSphere
+Model::getBoundingSphere(float scale) const
+{
+  return asset->getBoundingSphere(scale);
+}
 
-  modelMatrix = modelMatrix * glm::mat4_cast(finalRotation);
-  modelMatrix = glm::translate(modelMatrix, origin * glm::vec3(-1));
-  modelMatrix = glm::scale(modelMatrix, glm::vec3(scale, scale, scale));
-  glm::mat4 inverseModelMatrix = glm::inverse(modelMatrix);
-  glm::mat4 transposedInverse = glm::transpose(inverseModelMatrix);
-  normalMatrix = glm::mat3(transposedInverse);
+void
+Positionable::update()
+{
+  composeTransform(pos,
+                   origin,
+                   glm::quat(glm::radians(rotate)),
+                   scale,
+                   modelMatrix,
+                   normalMatrix);
   damaged = false;
 }
 
@@ -262,6 +550,10 @@ void
 Positionable::damage()
 {
   damaged = true;
+  if (damageQueue != nullptr && !queued) {
+    queued = true;
+    damageQueue->push_back(entity);
+  }
 }
 
 Positionable::Positionable(glm::vec3 pos,
@@ -0,0 +1,92 @@
+#include "presentLatency.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+void
+PresentLatency::committed(double now, bool counted)
+{
+  if (pendingCommit >= 0.0 && pendingCounted) {
+    droppedCount++;
+  }
+  pendingCommit = now;
+  pendingImport = -1.0;
+  pendingCounted = counted;
+}
+
+void
+PresentLatency::imported(double now)
+{
+  if (pendingCommit >= 0.0 && pendingImport < 0.0) {
+    pendingImport = now;
+  }
+}
+
+void
+PresentLatency::drawn(double now)
+{
+  if (pendingCommit < 0.0) {
+    // a redraw of a buffer that was already timed
+    return;
+  }
+  if (pendingCounted) {
+    drawnCommit = pendingCommit;
+    // scanout shows the buffer without importing it
+    drawnImport = pendingImport >= 0.0 ? pendingImport : now;
+    // a draw stamped before the import in the same frame took no time
+    drawnAt = std::max(now, drawnImport);
+  }
+  pendingCommit = -1.0;
+  pendingImport = -1.0;
+}
+
+double
+PresentLatency::presented(double now)
+{
+  if (drawnCommit < 0.0) {
+    return -1.0;
+  }
+  double latency = now - drawnCommit;
+  samples[next % SAMPLES] = { float(drawnImport - drawnCommit),
+                              float(drawnAt - drawnImport),
+                              float(now - drawnAt) };
+  next++;
+  presentedCount++;
+  drawnCommit = -1.0;
+  return latency;
+}
+
+PresentLatency::Summary
+PresentLatency::summary() const
+{
+  Summary summary;
+  summary.presented = presentedCount;
+  summary.dropped = droppedCount;
+  size_t count = std::min(next, SAMPLES);
+  if (count == 0) {
+    return summary;
+  }
+  std::vector<float> totals(count);
+  for (size_t i = 0; i < count; i++) {
+    const Stages& stages = samples[i];
+    totals[i] =
+      stages.commitToImport + stages.importToDraw + stages.drawToPresent;
+    summary.commitToImportMs += stages.commitToImport;
+    summary.importToDrawMs += stages.importToDraw;
+    summary.drawToPresentMs += stages.drawToPresent;
+  }
+  // nearest-rank percentiles
+  auto percentile = [&](double p) {
+    size_t rank = size_t(std::ceil(p * count)) - 1;
+    std::nth_element(totals.begin(), totals.begin() + rank, totals.end());
+    return totals[rank] * 1000.0;
+  };
+  summary.samples = uint32_t(count);
+  summary.p50Ms = percentile(0.50);
+  summary.p95Ms = percentile(0.95);
+  summary.p99Ms = percentile(0.99);
+  summary.commitToImportMs *= 1000.0 / count;
+  summary.importToDrawMs *= 1000.0 / count;
+  summary.drawToPresentMs *= 1000.0 / count;
+  return summary;
+}
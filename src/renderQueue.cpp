@@ -0,0 +1,136 @@
+#include "renderQueue.h"
+#include <algorithm>
+
+bool
+GlStateTracker::change(bool redundant)
+{
+  if (redundant) {
+    current.redundantStateChanges++;
+    return false;
+  }
+  current.stateChanges++;
+  return true;
+}
+
+void
+GlStateTracker::useProgram(Shader& shader)
+{
+  if (change(program == shader.ID)) {
+    program = shader.ID;
+    shader.use();
+  }
+}
+
+void
+GlStateTracker::bindVertexArray(GLuint newVertexArray)
+{
+  if (change(vertexArray == newVertexArray)) {
+    vertexArray = newVertexArray;
+    glBindVertexArray(vertexArray);
+  }
+}
+
+void
+GlStateTracker::activeTexture(unsigned int unit)
+{
+  if (change(activeUnit == unit)) {
+    activeUnit = unit;
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+}
+
+void
+GlStateTracker::bindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+  if (!texturesKnown) {
+    textures.fill(UNKNOWN);
+    texturesKnown = true;
+  }
+  if (unit < TRACKED_UNITS && textures[unit] == texture &&
+      targets[unit] == target) {
+    change(true);
+    return;
+  }
+  activeTexture(unit);
+  change(false);
+  glBindTexture(target, texture);
+  if (unit < TRACKED_UNITS) {
+    textures[unit] = texture;
+    targets[unit] = target;
+  }
+}
+
+void
+GlStateTracker::drawArrays(GLenum mode, GLint first, GLsizei count)
+{
+  current.drawCalls++;
+  glDrawArrays(mode, first, count);
+}
+
+void
+GlStateTracker::drawElements(GLenum mode, GLsizei count, GLenum type)
+{
+  current.drawCalls++;
+  glDrawElements(mode, count, type, 0);
+}
+
+void
+GlStateTracker::drawElementsInstanced(GLenum mode,
+                                      GLsizei count,
+                                      GLenum type,
+                                      GLsizei instances)
+{
+  current.drawCalls++;
+  glDrawElementsInstanced(mode, count, type, 0, instances);
+}
+
+void
+GlStateTracker::countDraw()
+{
+  current.drawCalls++;
+}
+
+void
+GlStateTracker::invalidate()
+{
+  program = UNKNOWN;
+  vertexArray = UNKNOWN;
+  activeUnit = UNKNOWN;
+  texturesKnown = false;
+}
+
+uint64_t
+RenderQueue::makeKey(RenderPass pass,
+                     GLuint program,
+                     GLuint material,
+                     GLuint vertexArray)
+{
+  // GL names are small integers in practice; the masks only keep an
+  // unexpectedly large one from bleeding into a more significant field
+  return (uint64_t(pass) << 56) | (uint64_t(program & 0xFFF) << 44) |
+         (uint64_t(material & 0x3FFFFF) << 22) |
+         uint64_t(vertexArray & 0x3FFFFF);
+}
+
+void
+RenderQueue::submit(DrawItem item)
+{
+  items.push_back(std::move(item));
+}
+
+void
+RenderQueue::sort()
+{
+  // stable so equal keys keep submission order and frames don't flicker
+  std::stable_sort(items.begin(),
+                   items.end(),
+                   [](const DrawItem& a, const DrawItem& b) {
+                     return a.key < b.key;
+                   });
+}
+
+void
+RenderQueue::clear()
+{
+  items.clear();
+}
@@ -9,6 +9,7 @@
 #include "AppSurface.h"
 #include "TypedKeyOverlay.h"
 #include "wayland_app.h"
+#include "appVisibility.h"
 #include "camera.h"
 #include "screen.h"
 #include "components/Bootable.h"
@@ -86,7 +87,39 @@ is_gles()
 #define DISABLE_CULLING true
 
 float HEIGHT = SCREEN_HEIGHT / SCREEN_WIDTH / 2.0;
-float MAX_LIGHTS = 5;
+// Handles for every uniform the renderer sets, so draws never build or hash
+// uniform name strings.
+namespace uniforms {
+const Uniform allBlocks("allBlocks");
+const Uniform appTex("appTex");
+const Uniform totalBlockTypes("totalBlockTypes");
+const Uniform SHADOWS_ENABLED("SHADOWS_ENABLED");
+const Uniform lookedAtValid("lookedAtValid");
+const Uniform isLookedAt("isLookedAt");
+const Uniform isMesh("isMesh");
+const Uniform isModel("isModel");
+const Uniform directRender("directRender");
+const Uniform isVoxel("isVoxel");
+const Uniform voxelsEnabled("voxelsEnabled");
+const Uniform uAmbientStrength("uAmbientStrength");
+const Uniform uTexture("uTexture");
+const Uniform isApp("isApp");
+const Uniform isDynamicObject("isDynamicObject");
+const Uniform isLine("isLine");
+const Uniform appTransparent("appTransparent");
+const Uniform model("model");
+const Uniform lookedAtBlockType("lookedAtBlockType");
+const Uniform appSelected("appSelected");
+const Uniform bootableScale("bootableScale");
+const Uniform fromLightIndex("fromLightIndex");
+const Uniform isLight("isLight");
+const Uniform normalMatrix("normalMatrix");
+const Uniform isInstanced("isInstanced");
+const Uniform shadowFace("shadowFace");
+const Uniform shadowMaps("shadowMaps");
+const Uniform clusterRanges("clusterRanges");
+const Uniform clusterLights("clusterLights");
+}
 
 float appVertices[] = {
   -0.5f, -HEIGHT, 0, 0.0f, 0.0f, 0.5f,  -HEIGHT, 0, 1.0f, 0.0f,
@@ -139,6 +172,129 @@ Renderer::genGlResources()
 
   genMeshResources();
   genDynamicObjectResources();
+  genUniformBuffers();
+  genLightClusterTextures();
+}
+
+void
+Renderer::genLightClusterTextures()
+{
+  // integer textures rather than SSBOs or texture buffers so this works on
+  // GLES 3.0
+  auto allocate = [](GLuint& texture, unsigned int unit) {
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  };
+  allocate(clusterRangeTexture, CLUSTER_RANGE_UNIT);
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_RG32UI,
+               lightClusters.getTilesX() * lightClusters.getTilesY(),
+               lightClusters.getSlices(),
+               0,
+               GL_RG_INTEGER,
+               GL_UNSIGNED_INT,
+               NULL);
+  allocate(clusterLightTexture, CLUSTER_LIGHT_UNIT);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void
+Renderer::uploadLightClusters()
+{
+  ZoneScoped;
+  glm::mat4 projection = camera->getProjectionMatrix();
+  if (projection != clusteredProjection) {
+    clusteredProjection = projection;
+    // recover the planes instead of asking the camera, so the clusters
+    // always match the matrix the frame was drawn with
+    float near = projection[3][2] / (projection[2][2] - 1.0f);
+    float far = projection[3][2] / (projection[2][2] + 1.0f);
+    lightClusters.setProjection(projection, near, far);
+  }
+  lightClusters.assign(viewLights);
+
+  auto& ranges = lightClusters.getRanges();
+  // the textures stay bound on their units for the camera pass
+  glState.activeTexture(CLUSTER_RANGE_UNIT);
+  glState.bindTexture(CLUSTER_RANGE_UNIT, GL_TEXTURE_2D, clusterRangeTexture);
+  glTexSubImage2D(GL_TEXTURE_2D,
+                  0,
+                  0,
+                  0,
+                  lightClusters.getTilesX() * lightClusters.getTilesY(),
+                  lightClusters.getSlices(),
+                  GL_RG_INTEGER,
+                  GL_UNSIGNED_INT,
+                  ranges.data());
+
+  auto& indices = lightClusters.getLightIndices();
+  int rows = std::max<int>(1, (indices.size() + CLUSTER_LIGHT_ROW - 1) /
+                                CLUSTER_LIGHT_ROW);
+  glState.activeTexture(CLUSTER_LIGHT_UNIT);
+  glState.bindTexture(CLUSTER_LIGHT_UNIT, GL_TEXTURE_2D, clusterLightTexture);
+  if (rows > clusterLightRows) {
+    clusterLightRows = rows;
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_R32UI,
+                 CLUSTER_LIGHT_ROW,
+                 clusterLightRows,
+                 0,
+                 GL_RED_INTEGER,
+                 GL_UNSIGNED_INT,
+                 NULL);
+  }
+  int fullRows = indices.size() / CLUSTER_LIGHT_ROW;
+  if (fullRows > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    0,
+                    0,
+                    CLUSTER_LIGHT_ROW,
+                    fullRows,
+                    GL_RED_INTEGER,
+                    GL_UNSIGNED_INT,
+                    indices.data());
+  }
+  int rest = indices.size() % CLUSTER_LIGHT_ROW;
+  if (rest > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    0,
+                    fullRows,
+                    rest,
+                    1,
+                    GL_RED_INTEGER,
+                    GL_UNSIGNED_INT,
+                    indices.data() + fullRows * CLUSTER_LIGHT_ROW);
+  }
+}
+
+void
+Renderer::genUniformBuffers()
+{
+  auto allocate = [](GlBuffer& buffer, GLsizeiptr size, GLuint binding) {
+    buffer.create(GL_UNIFORM_BUFFER);
+    buffer.bind();
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+  };
+  allocate(FRAME_UBO, sizeof(FrameBlock), FRAME_BLOCK_BINDING);
+  allocate(LIGHT_UBO, sizeof(LightBlock), LIGHT_BLOCK_BINDING);
+  allocate(SHADOW_UBO, sizeof(ShadowBlock), SHADOW_BLOCK_BINDING);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void
+Renderer::bindUniformBlocks(Shader* program)
+{
+  program->bindUniformBlock("FrameBlock", FRAME_BLOCK_BINDING);
+  program->bindUniformBlock("LightBlock", LIGHT_BLOCK_BINDING);
+  program->bindUniformBlock("ShadowBlock", SHADOW_BLOCK_BINDING);
 }
 
 void
@@ -295,6 +451,13 @@ Renderer::fillBuffers()
   fillDynamicObjectBuffers();
 }
 
+bool
+Renderer::shadersChanged()
+{
+  return (cameraShader && cameraShader->sourceCodeChanged()) ||
+         (depthShader && depthShader->sourceCodeChanged());
+}
+
 void
 Renderer::toggleWireframe()
 {
@@ -380,35 +543,40 @@ Renderer::Renderer(shared_ptr<EntityRegistry> registry,
   textures.insert(
     std::pair<string, Texture*>("allBlocks", new Texture(images, GL_TEXTURE0)));
   cameraShader = new Shader("shaders/vertex.glsl", "shaders/fragment.glsl");
-  shadowsEnabled = gl_version_at_least(3, 2);
+  bindUniformBlocks(cameraShader);
+  shadowsEnabled = gl_version_at_least(3, 0);
   if (!shadowsEnabled) {
-    logger->warn("Disabling shadows: GL version too low for geometry shader");
+    logger->warn("Disabling shadows: GL version too low for texture arrays");
   } else {
     depthShader = new Shader("shaders/depthVertex.glsl",
-                             "shaders/depthGeometry.glsl",
                              "shaders/depthFragment.glsl");
+    bindUniformBlocks(depthShader);
+    shadowAtlas.init();
   }
 
   shader = cameraShader;
 
   shader->use(); // may need to move into loop to use changing uniforms
 
-  shader->setInt("allBlocks", 0);
+  shader->setInt(uniforms::allBlocks, 0);
   // apps are on texture unit 0
-  shader->setInt("appTex", 0);
-  shader->setInt("totalBlockTypes", images.size());
-  shader->setBool("SHADOWS_ENABLED", shadowsEnabled);
+  shader->setInt(uniforms::appTex, 0);
+  shader->setInt(uniforms::totalBlockTypes, images.size());
+  shader->setBool(uniforms::SHADOWS_ENABLED, shadowsEnabled);
+  shader->setInt(uniforms::shadowMaps, ShadowAtlas::TEXTURE_UNIT);
+  shader->setInt(uniforms::clusterRanges, CLUSTER_RANGE_UNIT);
+  shader->setInt(uniforms::clusterLights, CLUSTER_LIGHT_UNIT);
 
   cursorShader = new Shader("shaders/cursor.vert", "shaders/cursor.frag");
 
-  shader->setBool("lookedAtValid", false);
-  shader->setBool("isLookedAt", false);
-  shader->setBool("isMesh", false);
-  shader->setBool("isModel", false);
-  shader->setBool("directRender", false);
-  shader->setBool("isVoxel", false);
-  shader->setBool("voxelsEnabled", voxelsEnabled);
-  shader->setFloat("uAmbientStrength", 0.001);
+  shader->setBool(uniforms::lookedAtValid, false);
+  shader->setBool(uniforms::isLookedAt, false);
+  shader->setBool(uniforms::isMesh, false);
+  shader->setBool(uniforms::isModel, false);
+  shader->setBool(uniforms::directRender, false);
+  shader->setBool(uniforms::isVoxel, false);
+  shader->setBool(uniforms::voxelsEnabled, voxelsEnabled);
+  shader->setFloat(uniforms::uAmbientStrength, 0.001);
 
   voxelSpace.add(glm::vec3(0, 4, 4), voxelSize);
   voxelSpace.add(glm::vec3(voxelSize, 4, 4), voxelSize);
@@ -514,15 +682,21 @@ Renderer::initCursorResources()
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   cursorShader->use();
-  cursorShader->setInt("uTexture", 0);
+  cursorShader->setInt(uniforms::uTexture, 0);
   cursorInitialized = true;
 }
 void
 Renderer::updateTransformMatrices()
 {
-  // Route camera transforms through Shader so hot reload/reset restores them.
-  shader->setMatrix4("view", camera->getViewMatrix());
-  shader->setMatrix4("projection", camera->getProjectionMatrix(true));
+  // shared by every program through FRAME_BLOCK_BINDING, so this is the only
+  // write of the frame's camera state
+  FrameBlock frame;
+  frame.view = camera->getViewMatrix();
+  frame.projection = camera->getProjectionMatrix(true);
+  frame.viewPos = camera->position;
+  frame.time = nowSeconds();
+  FRAME_UBO.bind();
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
 }
 
 void
@@ -641,16 +815,16 @@ Renderer::setLines(const std::vector<Line>& lines)
 void
 Renderer::renderDynamicObjects()
 {
-  shader->setBool("isApp", false);
-  shader->setBool("isModel", false);
-  shader->setBool("isVoxel", false);
-  shader->setBool("isDynamicObject", true);
-  shader->setBool("directRender", false);
-  shader->setBool("isLine", false);
-  glBindBuffer(GL_ARRAY_BUFFER, DYNAMIC_OBJECT_POSITIONS);
-  glBindVertexArray(DYNAMIC_OBJECT_VERTEX);
-  glDrawArrays(GL_TRIANGLES, 0, verticesInDynamicObjects);
-  shader->setBool("isDynamicObject", false);
+  if (verticesInDynamicObjects == 0) {
+    return;
+  }
+  DrawItem item;
+  item.pass = DYNAMIC_OBJECT_PASS;
+  item.key = RenderQueue::makeKey(
+    DYNAMIC_OBJECT_PASS, shader->ID, 0, DYNAMIC_OBJECT_VERTEX);
+  item.vertexArray = DYNAMIC_OBJECT_VERTEX;
+  item.count = verticesInDynamicObjects;
+  renderQueue.submit(item);
 }
 
 static bool
@@ -667,37 +841,6 @@ supportsFramebufferBlit()
          glBlitFramebuffer != nullptr;
 }
 
-static void
-readFramebufferToRgba(int width, int height, std::vector<unsigned char>& out)
-{
-  out.resize(static_cast<size_t>(width) * static_cast<size_t>(height) * 4);
-  GLint prevPack = 0;
-  glGetIntegerv(GL_PACK_ALIGNMENT, &prevPack);
-  glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
-  GLenum readFmt =
-#ifdef GL_BGRA
-    GL_BGRA
-#elif defined(GL_BGRA_EXT)
-    GL_BGRA_EXT
-#else
-    GL_RGBA
-#endif
-    ;
-  bool swapRB = (readFmt != GL_RGBA);
-
-  glReadPixels(0, 0, width, height, readFmt, GL_UNSIGNED_BYTE, out.data());
-
-  if (swapRB) {
-    size_t total = static_cast<size_t>(width) * static_cast<size_t>(height);
-    for (size_t i = 0; i < total; ++i) {
-      auto* px = out.data() + i * 4;
-      std::swap(px[0], px[2]);
-    }
-  }
-  glPixelStorei(GL_PACK_ALIGNMENT, prevPack);
-}
-
 void
 Renderer::drawAppDirect(AppSurface* app, Bootable* bootable)
 {
@@ -734,7 +877,7 @@ Renderer::drawAppDirect(AppSurface* app, Bootable* bootable)
       glActiveTexture(GL_TEXTURE0);
       glBindTexture(GL_TEXTURE_2D, app->getTextureId());
       glBindVertexArray(DIRECT_RENDER_VAO);
-      shader->setBool("directRender", true);
+      shader->setBool(uniforms::directRender, true);
       static int x = -1;
       static int y = -1;
       static glm::mat4 model;
@@ -762,51 +905,61 @@ Renderer::drawAppDirect(AppSurface* app, Bootable* bootable)
         x = bootable->x;
         y = bootable->y;
       }
-      shader->setBool("appTransparent", bootable->transparent);
-      shader->setMatrix4("model", model);
+      shader->setBool(uniforms::appTransparent, bootable->transparent);
+      shader->setMatrix4(uniforms::model, model);
       glDrawArrays(GL_TRIANGLES, 0, 6);
-      shader->setBool("directRender", false);
+      shader->setBool(uniforms::directRender, false);
     }
 }
 
 void
 Renderer::screenshotFromCurrentFramebuffer(int width, int height, unsigned int fbo)
 {
+  auto t = std::time(nullptr);
+  auto tm = *std::localtime(&t);
+  stringstream filenameSS;
+  filenameSS << "screenshots/" << std::put_time(&tm, "%d-%m-%Y %H-%M-%S.png");
+
+  string filename = filenameSS.str();
+  captureNextFrame([filename](const FrameCapture::Frame& frame) {
+    int channels = 4; // 4 for RGBA
+    // Do not flip here; wlr path already reads from the onscreen-oriented FBO.
+    stbi_write_png(filename.c_str(),
+                   frame.width,
+                   frame.height,
+                   channels,
+                   frame.rgba.data(),
+                   frame.width * channels);
+  });
+  captureFrame(width, height, fbo);
+}
+
+void
+Renderer::captureNextFrame(FrameCapture::Callback done)
+{
+  pendingCaptures.push_back(std::move(done));
+}
+
+void
+Renderer::captureFrame(int width, int height, unsigned int fbo)
+{
+  if (pendingCaptures.empty()) {
+    return;
+  }
   GLint prevReadFbo = 0;
-  GLint prevDrawFbo = 0;
   glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFbo);
-  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prevDrawFbo);
   if (fbo == 0 && currentFbo != 0) {
     fbo = currentFbo;
   }
   if (fbo != 0) {
     glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLint>(fbo));
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLint>(fbo));
 #ifdef GL_COLOR_ATTACHMENT0
     glReadBuffer(GL_COLOR_ATTACHMENT0);
 #endif
   }
-
-  auto t = std::time(nullptr);
-  auto tm = *std::localtime(&t);
-  stringstream filenameSS;
-  filenameSS << "screenshots/" << std::put_time(&tm, "%d-%m-%Y %H-%M-%S.png");
-
-  string filename = filenameSS.str();
-
-  std::vector<unsigned char> data;
-  readFramebufferToRgba(width, height, data);
-  std::thread saver([filename, width, height, data = std::move(data)]() mutable {
-    int channels = 4; // 4 for RGBA
-    // Do not flip here; wlr path already reads from the onscreen-oriented FBO.
-    stbi_flip_vertically_on_write(false);
-    stbi_write_png(
-      filename.c_str(), width, height, channels, data.data(), width * channels);
-  });
-  // Restore previous framebuffer bindings.
+  frameCapture.read(width, height, std::move(pendingCaptures));
+  pendingCaptures.clear();
   glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFbo);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFbo);
-  saver.detach();
 }
 
 void
@@ -878,35 +1031,34 @@ Renderer::renderLookedAtFace()
                     lookedAtFace.texCoords.data());
 
     glBindVertexArray(VOXEL_SELECTIONS);
-    shader->setBool("isLookedAt", true);
-    shader->setInt("lookedAtBlockType", lookedAtFace.blockTypes[0]);
-    shader->setBool("isMesh", true);
+    shader->setBool(uniforms::isLookedAt, true);
+    shader->setInt(uniforms::lookedAtBlockType, lookedAtFace.blockTypes[0]);
+    shader->setBool(uniforms::isMesh, true);
     glDrawArrays(GL_TRIANGLES, 0, 6);
   }
-  shader->setBool("isLookedAt", false);
-  shader->setBool("isMesh", false);
+  shader->setBool(uniforms::isLookedAt, false);
+  shader->setBool(uniforms::isMesh, false);
 }
 
 void
 Renderer::updateShaderUniforms()
 {
-  shader->setFloat("time", nowSeconds());
-  shader->setBool("isApp", false);
-  shader->setBool("isLine", false);
-  shader->setBool("isVoxel", false);
-  shader->setBool("voxelsEnabled", voxelsEnabled);
+  shader->setBool(uniforms::isApp, false);
+  shader->setBool(uniforms::isLine, false);
+  shader->setBool(uniforms::isVoxel, false);
+  shader->setBool(uniforms::voxelsEnabled, voxelsEnabled);
 }
 
 void
 Renderer::renderChunkMesh()
 {
-  shader->setBool("isMesh", true);
+  shader->setBool(uniforms::isMesh, true);
   glBindVertexArray(MESH_VERTEX);
   // TODO: fix this
   // glEnable(GL_CULL_FACE);
   glDisable(GL_CULL_FACE);
   glDrawArrays(GL_TRIANGLES, 0, verticesInMesh);
-  shader->setBool("isMesh", false);
+  shader->setBool(uniforms::isMesh, false);
 }
 
 void Renderer::renderPopup(WaylandApp::Component& popup, WaylandApp::Component& parent) {
@@ -955,6 +1107,32 @@ void Renderer::renderPopup(WaylandApp::Component& popup, WaylandApp::Component&
                       GL_COLOR_BUFFER_BIT,
                       GL_NEAREST);
     glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFbo);
+    popupApp->getLatency().drawn(nowSeconds());
+}
+
+bool
+Renderer::blitApp(WaylandApp* app)
+{
+  if (!app || !supportsFramebufferBlit()) {
+    return false;
+  }
+  if (app->needsTextureImport()) {
+    app->appTexture();
+  }
+  auto fbIt = frameBuffers.find(app->getTextureId());
+  if (fbIt == frameBuffers.end()) {
+    return false;
+  }
+  int w = app->getWidth();
+  int h = app->getHeight();
+  GLint prevReadFbo = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFbo);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbIt->second);
+  glBlitFramebuffer(
+    0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFbo);
+  app->getLatency().drawn(nowSeconds());
+  return true;
 }
 
 void
@@ -966,11 +1144,11 @@ Renderer::renderApps()
     registry->view<WaylandApp::Component, Positionable>(entt::exclude<Bootable>);
   size_t wlCount = wlPositionable.size_hint();
   TracyGpuZone("render apps");
-  shader->setBool("appSelected", false);
+  shader->setBool(uniforms::appSelected, false);
 
-  shader->setBool("isApp", true);
-  shader->setBool("directRender", false);
-  glBindVertexArray(APP_VAO);
+  shader->setBool(uniforms::isApp, true);
+  shader->setBool(uniforms::directRender, false);
+  glState.bindVertexArray(APP_VAO);
   // Defensive: ensure app quad attributes are enabled/bound even if VAO state
   // was clobbered by other GL paths.
   glBindBuffer(GL_ARRAY_BUFFER, APP_VBO);
@@ -982,8 +1160,7 @@ Renderer::renderApps()
   glDisable(GL_CULL_FACE);
 
   auto bindAppTexture = [&](WaylandApp* app) {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, app->getTextureId());
+    glState.bindTexture(0, GL_TEXTURE_2D, app->getTextureId());
     return true;
   };
   auto renderLayerShell = [&](WaylandApp::Component& comp) {
@@ -1030,14 +1207,36 @@ Renderer::renderApps()
                       GL_COLOR_BUFFER_BIT,
                       GL_NEAREST);
     glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFbo);
+    app->getLatency().drawn(nowSeconds());
   };
 
+  const glm::mat4 viewProjection =
+    camera->getProjectionMatrix(true) * camera->getViewMatrix();
+  const float halfHeight = appQuadHalfHeight(SCREEN_WIDTH, SCREEN_HEIGHT);
+  const double frameTime = nowSeconds();
+
   // Wayland apps: render any that were registered by the wlroots backend.
   for (auto [entity, comp, positionable] : wlPositionable.each()) {
     auto* app = comp.app.get();
     if (!app) {
       continue;
     }
+    bool focusedApp = wm && wm->getCurrentlyFocusedApp().has_value() &&
+                      wm->getCurrentlyFocusedApp().value() == entity;
+    // the focused app is also drawn straight to the screen at full size
+    app->setProjectedPixels(
+      focusedApp ? SCREEN_WIDTH * SCREEN_HEIGHT
+                 : projectedAppArea(viewProjection,
+                                    positionable.modelMatrix *
+                                      app->getHeightScalar(),
+                                    kAppQuadHalfWidth,
+                                    halfHeight,
+                                    SCREEN_WIDTH,
+                                    SCREEN_HEIGHT));
+    app->updateResolutionLod(focusedApp, frameTime);
+    if (!app->isVisible()) {
+      continue;
+    }
 
     // Upload latest buffer only when a new commit arrived, then bind to the
     // app's dedicated unit to avoid stale or shared textures when multiple
@@ -1055,38 +1254,37 @@ Renderer::renderApps()
     float sy = static_cast<float>(app->getHeight()) /
                static_cast<float>(SCREEN_HEIGHT);
     glm::mat4 model = positionable.modelMatrix;
-    shader->setMatrix4("model", model);
-    shader->setMatrix4("bootableScale", app->getHeightScalar());
-    shader->setBool("appTransparent", false);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
+    shader->setMatrix4(uniforms::model, model);
+    shader->setMatrix4(uniforms::bootableScale, app->getHeightScalar());
+    shader->setBool(uniforms::appTransparent, false);
+    glState.drawArrays(GL_TRIANGLES, 0, 6);
+    app->getLatency().drawn(nowSeconds());
 
     // If focused, also draw directly to screen to ensure visibility.
-    if (wm && wm->getCurrentlyFocusedApp().has_value() &&
-        wm->getCurrentlyFocusedApp().value() == entity) {
+    if (focusedApp) {
       if (!bindAppTexture(app)) {
         continue;
       }
-      shader->setBool("directRender", true);
+      shader->setBool(uniforms::directRender, true);
       glm::mat4 model = glm::mat4(1.0f);
       float sx = static_cast<float>(app->getWidth()) /
                  static_cast<float>(SCREEN_WIDTH);
       float sy = static_cast<float>(app->getHeight()) /
                  static_cast<float>(SCREEN_HEIGHT);
       model = glm::scale(model, glm::vec3(sx, sy, 1.0f));
-      shader->setMatrix4("model", model);
-      glBindVertexArray(DIRECT_RENDER_VAO);
+      shader->setMatrix4(uniforms::model, model);
+      glState.bindVertexArray(DIRECT_RENDER_VAO);
       GLboolean depthMask = GL_TRUE;
       glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
       glDisable(GL_DEPTH_TEST);
       glDepthMask(GL_FALSE); // avoid clobbering depth for in-world apps
-      glDrawArrays(GL_TRIANGLES, 0, 6);
+      glState.drawArrays(GL_TRIANGLES, 0, 6);
       glDepthMask(depthMask);
       glEnable(GL_DEPTH_TEST);
-      shader->setBool("directRender", false);
+      shader->setBool(uniforms::directRender, false);
       // Restore model matrix/VAO for subsequent in-world draws.
-      shader->setMatrix4("model", positionable.modelMatrix);
-      glBindVertexArray(APP_VAO);
+      shader->setMatrix4(uniforms::model, positionable.modelMatrix);
+      glState.bindVertexArray(APP_VAO);
     }
   }
 
@@ -1129,17 +1327,17 @@ Renderer::renderApps()
     }
   }
 
-  shader->setBool("isApp", false);
+  shader->setBool(uniforms::isApp, false);
 }
 
 void
 Renderer::renderLines()
 {
-  shader->setBool("isApp", false);
-  shader->setBool("isModel", false);
-  shader->setBool("isVoxel", false);
-  shader->setBool("isDynamicObject", false);
-  shader->setBool("isLine", true);
+  shader->setBool(uniforms::isApp, false);
+  shader->setBool(uniforms::isModel, false);
+  shader->setBool(uniforms::isVoxel, false);
+  shader->setBool(uniforms::isDynamicObject, false);
+  shader->setBool(uniforms::isLine, true);
   // Draw lines on top; depth test off for clear visibility of selection boxes.
   GLboolean depthEnabled = glIsEnabled(GL_DEPTH_TEST);
   if (depthEnabled) {
@@ -1152,7 +1350,7 @@ Renderer::renderLines()
     glEnable(GL_DEPTH_TEST);
   }
   glLineWidth(1.0f);
-  shader->setBool("isLine", false);
+  shader->setBool(uniforms::isLine, false);
 }
 
 void
@@ -1161,11 +1359,11 @@ Renderer::renderVoxels()
   if (!voxelsEnabled) {
     return;
   }
-  shader->setBool("isVoxel", true);
-  shader->setMatrix4("model", glm::mat4(1.0f));
+  shader->setBool(uniforms::isVoxel, true);
+  shader->setMatrix4(uniforms::model, glm::mat4(1.0f));
   glDisable(GL_CULL_FACE);
-  voxelMesh.draw();
-  shader->setBool("isVoxel", false);
+  voxelMesh.draw(glState);
+  shader->setBool(uniforms::isVoxel, false);
 }
 
 void
@@ -1221,92 +1419,136 @@ Renderer::voxelExistsAt(const glm::vec3& worldPosition, float size) const
   return voxelSpace.has(pos, s);
 }
 
+// matches the old per-light ambient strength in fragment.glsl
+static const float LIGHT_AMBIENT = 0.2f;
+
 void
 Renderer::lightUniforms(RenderPerspective perspective,
-                        std::optional<entt::entity> fromLight)
+                        std::optional<entt::entity> fromLight,
+                        int shadowFace)
 {
   auto lightView = registry->view<Light, Positionable>();
+  LightBlock lights = {};
   int lightIndex = 0;
-  int lastTextureUnit;
+  glm::mat4& view = camera->getViewMatrix();
+  viewLights.clear();
   for (auto [entity, light, positionable] : lightView.each()) {
-    shader->setVec3("lightPos[" + std::to_string(lightIndex) + "]",
-                    positionable.pos);
-    shader->setVec3("lightColor[" + std::to_string(lightIndex) + "]",
-                    light.color);
-    shader->setFloat("far_plane[" + std::to_string(lightIndex) + "]",
-                     light.farPlane);
-    if (perspective == LIGHT && fromLight == entity) {
-      shader->setInt("fromLightIndex", lightIndex);
-      cout << "lightIndex: " << lightIndex << endl;
-      for (unsigned int i = 0; i < 6; ++i) {
-        shader->setMatrix4("shadowMatrices[" + std::to_string(i) + "]",
-                           light.shadowTransforms[i]);
-      }
+    if (lightIndex >= MAX_LIGHTS) {
+      break;
     }
+    lights.lightPos[lightIndex] = glm::vec4(positionable.pos, light.farPlane);
+    lights.lightColor[lightIndex] = glm::vec4(light.color, 1.0f);
+    lights.ambientLight += glm::vec4(LIGHT_AMBIENT * light.color, 0.0f);
     if (perspective == CAMERA) {
-      shader->setInt("depthCubeMap" + std::to_string(lightIndex),
-                     light.textureUnit);
-      // THIS IS A HACK
-      lastTextureUnit = light.textureUnit;
+      viewLights.push(glm::vec3(view * glm::vec4(positionable.pos, 1.0f)),
+                      light.farPlane);
     }
-
-    // THIS IS A HACK. If I exceed 5 lights, use texture array (proper)
-    for (int i = lightIndex; i < MAX_LIGHTS; i++) {
-      shader->setInt("depthCubeMap" + std::to_string(i), light.textureUnit);
+    lights.shadowParams[lightIndex] =
+      light.shadowSlot >= 0 && light.shadowMapped
+               ? glm::vec4(light.shadowSlot * 6,
+                           float(light.mappedResolution) / ShadowAtlas::SIZE,
+                           0.0f,
+                           0.0f)
+               : glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f);
+    if (perspective == LIGHT && fromLight == entity) {
+      shader->setInt(uniforms::fromLightIndex, lightIndex);
+      shader->setInt(uniforms::shadowFace, shadowFace);
+      // the matrices are the same for all six faces
+      if (shadowFace == 0 && light.shadowTransforms.size() == 6) {
+        ShadowBlock shadow;
+        std::copy(light.shadowTransforms.begin(),
+                  light.shadowTransforms.end(),
+                  shadow.shadowMatrices);
+        SHADOW_UBO.bind();
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowBlock), &shadow);
+      }
     }
     lightIndex++;
   }
-  shader->setInt("numLights", lightIndex);
+  lights.numLights = lightIndex;
+  lights.clusterGrid = glm::vec4(lightClusters.getTilesX(),
+                                 lightClusters.getTilesY(),
+                                 lightClusters.getSlices(),
+                                 0.0f);
+  if (perspective == CAMERA) {
+    uploadLightClusters();
+  }
+  lights.clusterParams = glm::vec4(lightClusters.getDepthScale(),
+                                   lightClusters.getDepthBias(),
+                                   SCREEN_WIDTH / lightClusters.getTilesX(),
+                                   SCREEN_HEIGHT / lightClusters.getTilesY());
+
+  // the same block serves the camera and every shadow pass of the frame
+  if (!lightBlockUploaded ||
+      std::memcmp(&lights, &lightBlock, sizeof(LightBlock)) != 0) {
+    lightBlock = lights;
+    lightBlockUploaded = true;
+    LIGHT_UBO.bind();
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &lightBlock);
+  }
 }
 
 void
-Renderer::renderModels(RenderPerspective perspective)
+Renderer::updateModelInstances()
 {
-  TracyGpuZone("render models");
-  if(perspective != LIGHT) {
-    glEnable(GL_CULL_FACE);
-  }
-  auto frustum = camera->createFrustum();
-  shader->setBool("isModel", true);
-  shader->setVec3("viewPos", camera->position);
-  shader->setBool("isLight", false);
-
-  auto modelView = registry->view<Positionable, Model>();
-
-  bool hasLight = false;
-
-  set<entt::entity> lightEntities;
-  auto lightView = registry->view<Light, Positionable>();
-  for (auto [entity, light, positionable] : lightView.each()) {
-    lightEntities.insert(entity);
+  ZoneScoped;
+  for (auto& [asset, batch] : modelInstances) {
+    batch.instances.clear();
   }
-
-  static int lastCount = 0;
-  int count = 0;
+  // not culled: the camera moves before the next camera pass, and a caster
+  // outside the view still shadows what is in it
+  auto modelView = registry->view<Positionable, Model>(entt::exclude<Light>);
   for (auto [entity, p, m] : modelView.each()) {
-    bool shouldDraw = systems::isOnFrustum(registry, entity, frustum);
-    if(DISABLE_CULLING) {
-      shouldDraw = true;
+    auto& batch = modelInstances[&m.getAsset()];
+    if (!batch.asset) {
+      batch.asset = m.getSharedAsset();
     }
-    if (!shouldDraw) {
+    batch.instances.push_back({ p.modelMatrix, p.normalMatrix });
+  }
+  for (auto it = modelInstances.begin(); it != modelInstances.end();) {
+    auto& [asset, batch] = *it;
+    if (batch.instances.empty()) {
+      // let the asset be evicted once nothing draws it
+      it = modelInstances.erase(it);
       continue;
     }
-    if (!lightEntities.empty() && lightEntities.contains(entity)) {
-      shader->setBool("isLight", true);
-      if (perspective == LIGHT) {
-        shouldDraw = false;
-      }
-    }
-    auto normalMatrix = p.normalMatrix;
-    auto modelMatrix = p.modelMatrix;
-    shader->setMatrix3("normalMatrix", normalMatrix);
-    shader->setMatrix4("model", modelMatrix);
+    batch.asset->uploadInstances(batch.instances);
+    ++it;
+  }
+}
 
-    if (shouldDraw) {
+void
+Renderer::renderModels(RenderPerspective perspective)
+{
+  static int lastCount = 0;
+  int count = 0;
+  if (perspective != LIGHT) {
+    // lights are few and shaded differently; draw them one at a time
+    auto frustum = camera->createFrustum();
+    auto lightView = registry->view<Light, Positionable, Model>();
+    for (auto [entity, light, p, m] : lightView.each()) {
+      if (!DISABLE_CULLING &&
+          !systems::isOnFrustum(registry, entity, frustum)) {
+        continue;
+      }
       count++;
-      m.Draw(*shader);
+      DrawItem item;
+      item.pass = MODEL_PASS;
+      item.model = p.modelMatrix;
+      item.normalMatrix = p.normalMatrix;
+      item.isLight = true;
+      m.submit(renderQueue, shader->ID, item);
     }
-    shader->setBool("isLight", false);
+  }
+
+  // every other entity sharing an asset is one instanced draw per mesh, from
+  // the buffers updateModelInstances filled for this frame
+  for (auto& [asset, batch] : modelInstances) {
+    count += batch.instances.size();
+    DrawItem item;
+    item.pass = MODEL_PASS;
+    item.instanceCount = batch.instances.size();
+    batch.asset->submit(renderQueue, shader->ID, item);
   }
   if (count != lastCount) {
     stringstream countSS;
@@ -1314,12 +1556,110 @@ Renderer::renderModels(RenderPerspective perspective)
     logger->debug(countSS.str());
     lastCount = count;
   }
-  shader->setBool("isModel", false);
+}
+
+void
+Renderer::beginPass(RenderPass pass, RenderPerspective perspective)
+{
+  switch (pass) {
+    case DYNAMIC_OBJECT_PASS:
+      shader->setBool(uniforms::isApp, false);
+      shader->setBool(uniforms::isModel, false);
+      shader->setBool(uniforms::isVoxel, false);
+      shader->setBool(uniforms::isDynamicObject, true);
+      shader->setBool(uniforms::directRender, false);
+      shader->setBool(uniforms::isLine, false);
+      break;
+    case MODEL_PASS:
+      if (perspective != LIGHT) {
+        glEnable(GL_CULL_FACE);
+      }
+      shader->setBool(uniforms::isModel, true);
+      break;
+  }
+}
+
+void
+Renderer::endPass(RenderPass pass)
+{
+  switch (pass) {
+    case DYNAMIC_OBJECT_PASS:
+      shader->setBool(uniforms::isDynamicObject, false);
+      break;
+    case MODEL_PASS:
+      shader->setBool(uniforms::isModel, false);
+      shader->setBool(uniforms::isLight, false);
+      shader->setBool(uniforms::isInstanced, false);
+      break;
+  }
+}
+
+void
+Renderer::executeRenderQueue(RenderPerspective perspective)
+{
+  TracyGpuZone("render queue");
+  renderQueue.sort();
+  std::optional<RenderPass> pass;
+  for (auto& item : renderQueue.getItems()) {
+    if (pass != item.pass) {
+      if (pass.has_value()) {
+        endPass(pass.value());
+      }
+      beginPass(item.pass, perspective);
+      pass = item.pass;
+    }
+    if (item.textures) {
+      for (unsigned int i = 0; i < item.textures->size(); i++) {
+        // unit 0 belongs to the block atlas and app textures
+        glState.bindTexture(i + 1, GL_TEXTURE_2D, (*item.textures)[i].id);
+        shader->setInt((*item.textureUniforms)[i], i + 1);
+      }
+    }
+    if (item.pass == MODEL_PASS) {
+      shader->setBool(uniforms::isLight, item.isLight);
+      shader->setBool(uniforms::isInstanced, item.instanceCount > 0);
+      if (item.instanceCount == 0) {
+        shader->setMatrix3(uniforms::normalMatrix, item.normalMatrix);
+        shader->setMatrix4(uniforms::model, item.model);
+      }
+    }
+    glState.bindVertexArray(item.vertexArray);
+    if (item.instanceCount > 0) {
+      glState.drawElementsInstanced(
+        item.mode, item.count, GL_UNSIGNED_INT, item.instanceCount);
+    } else if (item.indexed) {
+      glState.drawElements(item.mode, item.count, GL_UNSIGNED_INT);
+    } else {
+      glState.drawArrays(item.mode, 0, item.count);
+    }
+  }
+  if (pass.has_value()) {
+    endPass(pass.value());
+  }
+  glState.activeTexture(0);
+  renderQueue.clear();
+}
+
+void
+Renderer::publishFrameStats()
+{
+  frameStats = glState.stats();
+  glState.stats() = RenderStats();
+  for (auto* program : { cameraShader, depthShader }) {
+    if (program == nullptr) {
+      continue;
+    }
+    frameStats.uniformWrites += program->uniformWrites;
+    frameStats.redundantUniformWrites += program->redundantUniformWrites;
+    program->uniformWrites = 0;
+    program->redundantUniformWrites = 0;
+  }
 }
 
 void
 Renderer::render(RenderPerspective perspective,
-                 std::optional<entt::entity> fromLight)
+                 std::optional<entt::entity> fromLight,
+                 int shadowFace)
 {
   ZoneScoped;
   TracyGpuZone("render");
@@ -1340,10 +1680,13 @@ Renderer::render(RenderPerspective perspective,
   glGetIntegerv(GL_FRAMEBUFFER_BINDING, &boundFbo);
   currentFbo = static_cast<unsigned int>(boundFbo);
   glFrontFace(invertY ? GL_CW : GL_CCW);
+  // whatever ran since the last pass (imgui, wlroots, light setup) may have
+  // rebound anything
+  glState.invalidate();
   if (perspective == CAMERA) {
     shader = cameraShader;
     shader->reloadIfChanged();
-    shader->use();
+    glState.useProgram(*shader);
     // must use prior to updating uniforms
 
     camera->tick();
@@ -1354,21 +1697,32 @@ Renderer::render(RenderPerspective perspective,
     }
     shader = depthShader;
     shader->reloadIfChanged();
-    shader->use();
+    glState.useProgram(*shader);
   }
   updateShaderUniforms();
-  lightUniforms(perspective, fromLight);
+  lightUniforms(perspective, fromLight, shadowFace);
+  if (perspective == CAMERA && shadowsEnabled) {
+    glState.bindTexture(ShadowAtlas::TEXTURE_UNIT,
+                        GL_TEXTURE_2D_ARRAY,
+                        shadowAtlas.getTexture());
+  }
   renderDynamicObjects();
   renderModels(perspective);
+  executeRenderQueue(perspective);
   if (perspective == CAMERA) {
     renderVoxels();
     renderApps();
+    // popups and layer shells import and blit outside the tracker
+    glState.invalidate();
     if (typedKeyOverlay) {
       typedKeyOverlay->render(cursorShader,
                               SCREEN_WIDTH,
                               SCREEN_HEIGHT,
                               wm && wm->hasCurrentOrPendingFocus());
+      glState.countDraw();
     }
+    // the camera pass closes the frame; shadow passes ran before it
+    publishFrameStats();
   }
   //renderChunkMesh();
 }
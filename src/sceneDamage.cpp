@@ -0,0 +1,41 @@
+#include "sceneDamage.h"
+#include <atomic>
+#include <mutex>
+
+namespace {
+std::atomic_bool dirty = true;
+// the API thread can wake while the compositor installs or clears the waker
+std::mutex wakerMutex;
+std::function<void()> waker;
+}
+
+void
+sceneDamage::mark()
+{
+  // only the first mark after a frame needs to wake anything
+  if (!dirty.exchange(true)) {
+    wake();
+  }
+}
+
+void
+sceneDamage::wake()
+{
+  std::lock_guard<std::mutex> lock(wakerMutex);
+  if (waker) {
+    waker();
+  }
+}
+
+bool
+sceneDamage::consume()
+{
+  return dirty.exchange(false);
+}
+
+void
+sceneDamage::setWaker(std::function<void()> newWaker)
+{
+  std::lock_guard<std::mutex> lock(wakerMutex);
+  waker = std::move(newWaker);
+}
@@ -12,6 +12,42 @@ namespace fs = std::filesystem;
 
 #include <glm/gtc/type_ptr.hpp>
 
+static std::vector<std::string>&
+uniformNames()
+{
+  static std::vector<std::string> names;
+  return names;
+}
+
+Uniform::Uniform(const std::string& name)
+{
+  static std::unordered_map<std::string, int> ids;
+  auto found = ids.find(name);
+  if (found != ids.end()) {
+    index = found->second;
+    return;
+  }
+  index = uniformNames().size();
+  uniformNames().push_back(name);
+  ids[name] = index;
+}
+
+const std::string&
+Uniform::name() const
+{
+  return uniformNames()[index];
+}
+
+std::vector<Uniform>
+uniformArray(const std::string& name, int count)
+{
+  std::vector<Uniform> uniforms;
+  for (int i = 0; i < count; i++) {
+    uniforms.push_back(Uniform(name + "[" + std::to_string(i) + "]"));
+  }
+  return uniforms;
+}
+
 std::string
 retrieveShaderCode(std::string path)
 {
@@ -148,7 +184,8 @@ rewriteToGLES(const std::string& source, bool want320)
                "precision highp float;\n"
                "precision highp int;\n"
                "precision highp sampler2DArray;\n"
-               "precision highp samplerCube;\n");
+               "precision highp samplerCube;\n"
+               "precision highp usampler2D;\n");
   }
   return out;
 }
@@ -276,7 +313,7 @@ Shader::reloadIfChanged()
 }
 
 void
-Shader::restoreUniforms() const
+Shader::restoreUniforms()
 {
   if (ID == 0) {
     return;
@@ -286,72 +323,195 @@ Shader::restoreUniforms() const
   glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
   glUseProgram(ID);
 
-  for (const auto& [name, value] : boolUniforms) {
-    const_cast<Shader*>(this)->setBool(name, value);
+  // locations belong to the old program; re-resolve and replay
+  for (int i = 0; i < uniformSlots.size(); i++) {
+    auto& uniformSlot = uniformSlots[i];
+    uniformSlot.location = glGetUniformLocation(ID, uniformNames()[i].c_str());
+    uniformSlot.resolved = true;
+    if (uniformSlot.type != 0) {
+      upload(uniformSlot);
+    }
   }
-  for (const auto& [name, value] : intUniforms) {
-    const_cast<Shader*>(this)->setInt(name, value);
+  for (auto& [name, binding] : uniformBlocks) {
+    applyUniformBlock(name, binding);
   }
-  for (const auto& [name, value] : floatUniforms) {
-    const_cast<Shader*>(this)->setFloat(name, value);
+
+  glUseProgram(previousProgram);
+}
+
+void
+Shader::applyUniformBlock(const std::string& name, GLuint binding)
+{
+  GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+  if (index != GL_INVALID_INDEX) {
+    glUniformBlockBinding(ID, index, binding);
   }
-  for (const auto& [name, value] : vec3Uniforms) {
-    const_cast<Shader*>(this)->setVec3(name, value);
+}
+
+void
+Shader::bindUniformBlock(const std::string& name, GLuint binding)
+{
+  for (auto& block : uniformBlocks) {
+    if (block.first == name) {
+      block.second = binding;
+      applyUniformBlock(name, binding);
+      return;
+    }
   }
-  for (const auto& [name, value] : mat4Uniforms) {
-    const_cast<Shader*>(this)->setMatrix4(name, value);
+  uniformBlocks.push_back({ name, binding });
+  applyUniformBlock(name, binding);
+}
+
+void
+Shader::use()
+{
+  glUseProgram(ID);
+}
+
+Shader::UniformSlot&
+Shader::slot(Uniform uniform)
+{
+  if (uniform.id() >= uniformSlots.size()) {
+    uniformSlots.resize(uniform.id() + 1);
   }
-  for (const auto& [name, value] : mat3Uniforms) {
-    const_cast<Shader*>(this)->setMatrix3(name, value);
+  auto& uniformSlot = uniformSlots[uniform.id()];
+  if (!uniformSlot.resolved) {
+    uniformSlot.location = glGetUniformLocation(ID, uniform.name().c_str());
+    uniformSlot.resolved = true;
   }
+  return uniformSlot;
+}
 
-  glUseProgram(previousProgram);
+bool
+Shader::store(UniformSlot& uniformSlot,
+              GLenum type,
+              const void* value,
+              size_t size)
+{
+  if (uniformSlot.type == type &&
+      memcmp(uniformSlot.value, value, size) == 0) {
+    redundantUniformWrites++;
+    return false;
+  }
+  uniformWrites++;
+  uniformSlot.type = type;
+  memcpy(uniformSlot.value, value, size);
+  return true;
 }
 
 void
-Shader::use()
+Shader::upload(const UniformSlot& uniformSlot)
 {
-  glUseProgram(ID);
+  if (uniformSlot.location < 0) {
+    return;
+  }
+  const float* value = uniformSlot.value;
+  switch (uniformSlot.type) {
+    case GL_BOOL:
+    case GL_INT: {
+      int asInt;
+      memcpy(&asInt, value, sizeof(int));
+      glUniform1i(uniformSlot.location, asInt);
+      break;
+    }
+    case GL_FLOAT:
+      glUniform1f(uniformSlot.location, value[0]);
+      break;
+    case GL_FLOAT_VEC3:
+      glUniform3fv(uniformSlot.location, 1, value);
+      break;
+    case GL_FLOAT_MAT3:
+      glUniformMatrix3fv(uniformSlot.location, 1, GL_FALSE, value);
+      break;
+    case GL_FLOAT_MAT4:
+      glUniformMatrix4fv(uniformSlot.location, 1, GL_FALSE, value);
+      break;
+  }
+}
+
+void
+Shader::setBool(Uniform uniform, bool value)
+{
+  int asInt = value;
+  auto& uniformSlot = slot(uniform);
+  if (store(uniformSlot, GL_BOOL, &asInt, sizeof(int))) {
+    upload(uniformSlot);
+  }
+}
+void
+Shader::setInt(Uniform uniform, int value)
+{
+  auto& uniformSlot = slot(uniform);
+  if (store(uniformSlot, GL_INT, &value, sizeof(int))) {
+    upload(uniformSlot);
+  }
+}
+void
+Shader::setFloat(Uniform uniform, float value)
+{
+  auto& uniformSlot = slot(uniform);
+  if (store(uniformSlot, GL_FLOAT, &value, sizeof(float))) {
+    upload(uniformSlot);
+  }
+}
+
+void
+Shader::setMatrix4(Uniform uniform, const glm::mat4& value)
+{
+  auto& uniformSlot = slot(uniform);
+  if (store(uniformSlot, GL_FLOAT_MAT4, &value[0][0], sizeof(glm::mat4))) {
+    upload(uniformSlot);
+  }
+}
+
+void
+Shader::setMatrix3(Uniform uniform, const glm::mat3& value)
+{
+  auto& uniformSlot = slot(uniform);
+  if (store(uniformSlot, GL_FLOAT_MAT3, &value[0][0], sizeof(glm::mat3))) {
+    upload(uniformSlot);
+  }
+}
+
+void
+Shader::setVec3(Uniform uniform, const glm::vec3& value)
+{
+  auto& uniformSlot = slot(uniform);
+  if (store(uniformSlot, GL_FLOAT_VEC3, &value[0], sizeof(glm::vec3))) {
+    upload(uniformSlot);
+  }
 }
 
 void
 Shader::setBool(const std::string& name, bool value)
 {
-  boolUniforms[name] = value;
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+  setBool(Uniform(name), value);
 }
 void
 Shader::setInt(const std::string& name, int value)
 {
-  intUniforms[name] = value;
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+  setInt(Uniform(name), value);
 }
 void
 Shader::setFloat(const std::string& name, float value)
 {
-  floatUniforms[name] = value;
-  glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+  setFloat(Uniform(name), value);
 }
 
 void
 Shader::setMatrix4(const std::string& name, const glm::mat4& value)
 {
-  mat4Uniforms[name] = value;
-  glUniformMatrix4fv(
-    glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+  setMatrix4(Uniform(name), value);
 }
 
 void
 Shader::setMatrix3(const std::string& name, const glm::mat3& value)
 {
-  mat3Uniforms[name] = value;
-  glUniformMatrix3fv(
-    glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &value[0][0]);
+  setMatrix3(Uniform(name), value);
 }
 
 void
 Shader::setVec3(const std::string& name, const glm::vec3& value)
 {
-  vec3Uniforms[name] = value;
-  glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+  setVec3(Uniform(name), value);
 }
@@ -0,0 +1,145 @@
+#include "shadowAtlas.h"
+#include <algorithm>
+#include <unordered_set>
+
+ShadowAtlas::~ShadowAtlas()
+{
+  if (framebuffer != 0) {
+    glDeleteFramebuffers(1, &framebuffer);
+  }
+  if (texture != 0) {
+    glDeleteTextures(1, &texture);
+  }
+}
+
+void
+ShadowAtlas::init()
+{
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  // depth written by depthFragment.glsl is linear distance / far plane, so 16
+  // bits is plenty and halves the memory of a float format
+  glTexImage3D(GL_TEXTURE_2D_ARRAY,
+               0,
+               GL_DEPTH_COMPONENT16,
+               SIZE,
+               SIZE,
+               SLOTS * 6,
+               0,
+               GL_DEPTH_COMPONENT,
+               GL_UNSIGNED_SHORT,
+               nullptr);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glActiveTexture(GL_TEXTURE0);
+
+  glGenFramebuffers(1, &framebuffer);
+  GLint prevFbo = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  GLenum none = GL_NONE;
+  glDrawBuffers(1, &none);
+  glReadBuffer(GL_NONE);
+  glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+}
+
+void
+ShadowAtlas::render(int slot,
+                    int resolution,
+                    const std::function<void(int face)>& renderFace)
+{
+  int viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLint prevFbo = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, resolution, resolution);
+  for (int face = 0; face < 6; face++) {
+    // a single layer, so the clear in the depth pass leaves the other
+    // slots alone
+    glFramebufferTextureLayer(
+      GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, slot * 6 + face);
+    renderFace(face);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+std::vector<uint32_t>
+assignShadowSlots(const std::vector<uint32_t>& current,
+                  std::vector<ShadowCandidate> candidates,
+                  size_t slots,
+                  float hysteresis)
+{
+  std::unordered_set<uint32_t> holders(current.begin(), current.end());
+  auto rank = [&](const ShadowCandidate& candidate) {
+    return holders.contains(candidate.id) ? candidate.relevance * hysteresis
+                                          : candidate.relevance;
+  };
+  // ties go to the lower id so the result doesn't depend on input order
+  std::sort(candidates.begin(),
+            candidates.end(),
+            [&](const ShadowCandidate& a, const ShadowCandidate& b) {
+              float rankA = rank(a), rankB = rank(b);
+              return rankA != rankB ? rankA > rankB : a.id < b.id;
+            });
+  if (candidates.size() > slots) {
+    candidates.resize(slots);
+  }
+  std::unordered_set<uint32_t> winners;
+  for (auto& candidate : candidates) {
+    winners.insert(candidate.id);
+  }
+
+  std::vector<uint32_t> assigned(slots, NO_SHADOW);
+  for (size_t i = 0; i < slots && i < current.size(); i++) {
+    if (winners.contains(current[i])) {
+      assigned[i] = current[i];
+      winners.erase(current[i]);
+    }
+  }
+  size_t free = 0;
+  for (auto& candidate : candidates) {
+    if (!winners.contains(candidate.id)) {
+      continue;
+    }
+    while (assigned[free] != NO_SHADOW) {
+      free++;
+    }
+    assigned[free] = candidate.id;
+  }
+  return assigned;
+}
+
+namespace {
+int
+resolutionAt(float distance, float range)
+{
+  if (distance <= range) {
+    return ShadowAtlas::SIZE;
+  }
+  if (distance <= range * 3.0f) {
+    return ShadowAtlas::SIZE / 2;
+  }
+  return ShadowAtlas::SIZE / 4;
+}
+}
+
+int
+shadowResolution(float distance, float range, int current, float hysteresis)
+{
+  int resolution = resolutionAt(distance, range);
+  if (current <= 0 || resolution == current) {
+    return resolution;
+  }
+  // only switch when the margin doesn't bring us back to current
+  if (resolution < current) {
+    return resolutionAt(distance / hysteresis, range) < current ? resolution
+                                                                : current;
+  }
+  return resolutionAt(distance * hysteresis, range) > current ? resolution
+                                                              : current;
+}
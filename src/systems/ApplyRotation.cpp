@@ -3,23 +3,17 @@
 #include "glm/ext/quaternion_trigonometric.hpp"
 #include "glm/gtx/transform.hpp"
 #include "model.h"
-#include "components/Parent.h"
 #include <glm/gtc/quaternion.hpp>
-#include "time_utils.h"
+#include "systems/Simulation.h"
 
 double MIN_ROTATION = 0.0001;
 void
-systems::applyRotation(std::shared_ptr<EntityRegistry> registry)
+systems::applyRotation(std::shared_ptr<EntityRegistry> registry, double dt)
 {
-  // initialize to current time on first call
-  static double lastRotated = nowSeconds();
-
-  double curTime = nowSeconds();
-
   auto toRotate = registry->view<Positionable, RotateMovement>();
   for (auto [entity, positionable, rotateMovement] : toRotate.each()) {
-    auto degreesToRotate =
-      rotateMovement.degreesPerSecond * (curTime - lastRotated);
+    auto& simulated = systems::simulatedTransform(registry, entity);
+    auto degreesToRotate = rotateMovement.degreesPerSecond * dt;
 
     // Ensure degrees are always positive for 'min' calculation
     degreesToRotate = fabs(degreesToRotate);
@@ -34,9 +28,7 @@ systems::applyRotation(std::shared_ptr<EntityRegistry> registry)
 
     glm::quat rotation =
       glm::angleAxis(glm::radians((float)degreesToRotate), rotateMovement.axis);
-    glm::quat curQuat(glm::radians(positionable.rotate));
-    auto newQuat = curQuat * rotation;
-    positionable.rotate = glm::degrees(glm::eulerAngles(newQuat));
+    simulated.rotation = simulated.rotation * rotation;
 
     if (fabs(rotateMovement.degrees) < MIN_ROTATION) { // Account for negatives
       if (rotateMovement.onFinish.has_value()) {
@@ -44,36 +36,5 @@ systems::applyRotation(std::shared_ptr<EntityRegistry> registry)
       }
       registry->remove<RotateMovement>(entity);
     }
-    positionable.damage();
-
-    auto parent = registry->try_get<Parent>(entity);
-    if (parent != NULL) {
-      for (auto childId : parent->childrenIds) {
-        auto childEntityOpt = registry->locateEntity(childId);
-        if (childEntityOpt.has_value()) {
-          auto childEntity = childEntityOpt.value();
-
-          auto& childPositionable = registry->get<Positionable>(childEntity);
-
-          // Calculate child's position relative to parent
-          glm::vec3 relativePosition = childPositionable.pos - positionable.pos;
-          auto rotationMatrix = glm::rotate(
-            glm::radians((float)degreesToRotate), rotateMovement.axis);
-          glm::vec3 rotatedPosition =
-            rotationMatrix * glm::vec4(relativePosition, 1.0f);
-
-          // Calculate child's new world position
-          childPositionable.pos = rotatedPosition + positionable.pos;
-
-          glm::quat childQuat(glm::radians(childPositionable.rotate));
-          auto newChildQuat = rotation * childQuat;
-          childPositionable.rotate =
-            glm::degrees(glm::eulerAngles(newChildQuat));
-
-          childPositionable.damage();
-        }
-      }
-    }
   }
-  lastRotated = curTime;
 }
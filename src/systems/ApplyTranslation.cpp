@@ -4,25 +4,19 @@
 #include "glm/geometric.hpp"
 #include "glm/gtx/transform.hpp"
 #include "model.h"
-#include "components/Parent.h"
 #include <glm/gtc/quaternion.hpp>
-#include "time_utils.h"
+#include "systems/Simulation.h"
 
 double MIN_DELTA = 0.0001;
 void
-systems::applyTranslations(std::shared_ptr<EntityRegistry> registry)
+systems::applyTranslations(std::shared_ptr<EntityRegistry> registry, double dt)
 {
-  // initialize to current time on first call
-  static double lastTranslated = nowSeconds();
-
-  double curTime = nowSeconds();
-
   auto toRotate = registry->view<Positionable, TranslateMovement>();
   for (auto [entity, positionable, translateMovement] : toRotate.each()) {
+    auto& simulated = systems::simulatedTransform(registry, entity);
 
     glm::vec3 direction = glm::normalize(translateMovement.delta);
-    float distance =
-      translateMovement.unitsPerSecond * (curTime - lastTranslated);
+    float distance = translateMovement.unitsPerSecond * dt;
     glm::vec3 delta = direction * distance;
 
     // Ensure degrees are always positive for 'min' calculation
@@ -34,7 +28,7 @@ systems::applyTranslations(std::shared_ptr<EntityRegistry> registry)
 
     translateMovement.delta -= delta;
 
-    positionable.pos += delta;
+    simulated.pos += delta;
 
     if (glm::length(translateMovement.delta) <
         MIN_DELTA) { // Account for negatives
@@ -43,20 +37,5 @@ systems::applyTranslations(std::shared_ptr<EntityRegistry> registry)
       }
       registry->remove<TranslateMovement>(entity);
     }
-    positionable.damage();
-
-    auto parent = registry->try_get<Parent>(entity);
-    if (parent != NULL) {
-      for (auto childId : parent->childrenIds) {
-        auto childEntityOpt = registry->locateEntity(childId);
-        if (childEntityOpt.has_value()) {
-          auto childEntity = childEntityOpt.value();
-          auto& childPositionable = registry->get<Positionable>(childEntity);
-          childPositionable.pos += delta;
-          childPositionable.damage();
-        }
-      }
-    }
   }
-  lastTranslated = curTime;
 }
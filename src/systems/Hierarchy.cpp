@@ -0,0 +1,194 @@
+#include "systems/Hierarchy.h"
+#include "components/Parent.h"
+#include "model.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+void
+TransformHierarchy::invalidate(entt::registry&, entt::entity)
+{
+  stale = true;
+}
+
+void
+TransformHierarchy::markMoved(entt::entity entity)
+{
+  movedEntities.push_back(entity);
+}
+
+size_t
+TransformHierarchy::size() const
+{
+  return entities.size();
+}
+
+void
+TransformHierarchy::captureLocal(int node)
+{
+  int parent = parentIndex[node];
+  glm::quat toParent = glm::conjugate(worldRot[parent]);
+  localPos[node] = toParent * (worldPos[node] - worldPos[parent]);
+  localRot[node] = glm::normalize(toParent * worldRot[node]);
+}
+
+void
+TransformHierarchy::rebuild(EntityRegistry& registry)
+{
+  // this frame's moves may already be written into Positionable, so nodes
+  // that survive the rebuild keep the world transform they had last frame
+  // and only new nodes read theirs
+  std::unordered_map<entt::entity, int> previousIndex;
+  std::vector<glm::vec3> previousPos;
+  std::vector<glm::quat> previousRot;
+  previousIndex.swap(indexOf);
+  previousPos.swap(worldPos);
+  previousRot.swap(worldRot);
+
+  entities.clear();
+  parentIndex.clear();
+  subtreeSize.clear();
+
+  std::unordered_map<entt::entity, std::vector<entt::entity>> children;
+  std::unordered_set<entt::entity> isChild;
+  auto parents = registry.view<Parent, Positionable>();
+  for (auto [entity, parent, _positionable] : parents.each()) {
+    for (auto childId : parent.childrenIds) {
+      auto child = registry.locateEntity(childId);
+      if (child.has_value() && child.value() != entity &&
+          registry.all_of<Positionable>(child.value())) {
+        children[entity].push_back(child.value());
+        isChild.insert(child.value());
+      }
+    }
+  }
+
+  // depth-first so every subtree ends up contiguous; an entity listed under
+  // more than one parent (or in a cycle) is only placed once
+  std::function<void(entt::entity, int)> visit = [&](entt::entity entity,
+                                                     int parent) {
+    if (indexOf.contains(entity)) {
+      return;
+    }
+    int index = entities.size();
+    indexOf[entity] = index;
+    entities.push_back(entity);
+    parentIndex.push_back(parent);
+    subtreeSize.push_back(1);
+    auto found = children.find(entity);
+    if (found != children.end()) {
+      for (auto child : found->second) {
+        visit(child, index);
+      }
+    }
+    subtreeSize[index] = entities.size() - index;
+  };
+  for (auto [entity, _parent, _positionable] : parents.each()) {
+    if (!isChild.contains(entity)) {
+      visit(entity, -1);
+    }
+  }
+
+  size_t count = entities.size();
+  worldPos.resize(count);
+  worldRot.resize(count);
+  localPos.resize(count);
+  localRot.resize(count);
+  moved.assign(count, 0);
+  for (int node = 0; node < count; node++) {
+    auto previous = previousIndex.find(entities[node]);
+    if (previous != previousIndex.end()) {
+      worldPos[node] = previousPos[previous->second];
+      worldRot[node] = previousRot[previous->second];
+    } else {
+      auto& positionable = registry.get<Positionable>(entities[node]);
+      worldPos[node] = positionable.pos;
+      worldRot[node] = glm::quat(glm::radians(positionable.rotate));
+    }
+    if (parentIndex[node] >= 0) {
+      captureLocal(node);
+    }
+  }
+  dirtyRoots.clear();
+  stale = false;
+}
+
+void
+TransformHierarchy::propagate(EntityRegistry& registry)
+{
+  if (stale) {
+    rebuild(registry);
+  }
+
+  for (auto entity : movedEntities) {
+    auto found = indexOf.find(entity);
+    if (found != indexOf.end() && !moved[found->second]) {
+      moved[found->second] = 1;
+      dirtyRoots.push_back(found->second);
+    }
+  }
+  movedEntities.clear();
+  if (dirtyRoots.empty()) {
+    return;
+  }
+
+  std::sort(dirtyRoots.begin(), dirtyRoots.end());
+  int end = 0;
+  for (auto root : dirtyRoots) {
+    if (root < end) {
+      // already re-derived as part of an ancestor's subtree
+      continue;
+    }
+    end = root + subtreeSize[root];
+    for (int node = root; node < end; node++) {
+      auto& positionable = registry.get<Positionable>(entities[node]);
+      if (moved[node]) {
+        // moved on its own: take the new world transform as given and keep
+        // it attached at its new offset
+        moved[node] = 0;
+        worldPos[node] = positionable.pos;
+        worldRot[node] = glm::quat(glm::radians(positionable.rotate));
+        if (parentIndex[node] >= 0) {
+          captureLocal(node);
+        }
+        continue;
+      }
+      int parent = parentIndex[node];
+      worldRot[node] = glm::normalize(worldRot[parent] * localRot[node]);
+      worldPos[node] = worldPos[parent] + worldRot[parent] * localPos[node];
+      positionable.pos = worldPos[node];
+      positionable.rotate = glm::degrees(glm::eulerAngles(worldRot[node]));
+      positionable.damage();
+    }
+  }
+  dirtyRoots.clear();
+}
+
+TransformHierarchy&
+systems::transformHierarchy(std::shared_ptr<EntityRegistry> registry)
+{
+  auto& ctx = registry->ctx();
+  if (ctx.contains<TransformHierarchy>()) {
+    return ctx.get<TransformHierarchy>();
+  }
+  auto& hierarchy = ctx.emplace<TransformHierarchy>();
+  registry->on_construct<Parent>()
+    .connect<&TransformHierarchy::invalidate>(hierarchy);
+  registry->on_update<Parent>()
+    .connect<&TransformHierarchy::invalidate>(hierarchy);
+  registry->on_destroy<Parent>()
+    .connect<&TransformHierarchy::invalidate>(hierarchy);
+  registry->on_construct<Positionable>()
+    .connect<&TransformHierarchy::invalidate>(hierarchy);
+  registry->on_destroy<Positionable>()
+    .connect<&TransformHierarchy::invalidate>(hierarchy);
+  return hierarchy;
+}
+
+void
+systems::propagateTransforms(std::shared_ptr<EntityRegistry> registry)
+{
+  ZoneScoped;
+  transformHierarchy(registry).propagate(*registry);
+}
@@ -2,15 +2,189 @@
 #include "components/Light.h"
 #include "model.h"
 #include "renderer.h"
+#include "sceneDamage.h"
+#include "shadowAtlas.h"
+#include "systems/Intersections.h"
+#include "time_utils.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+
+namespace {
+void
+invalidateLights(EntityRegistry& registry,
+                 const std::vector<BoundingSphere>& bounds,
+                 const std::vector<entt::entity>& movedLights,
+                 bool unbounded)
+{
+  auto view = registry.view<Light, Positionable>();
+  for (auto [entity, light, positionable] : view.each()) {
+    bool affected = unbounded ||
+                    std::find(movedLights.begin(), movedLights.end(),
+                              entity) != movedLights.end();
+    for (int i = 0; !affected && i < bounds.size(); i++) {
+      float reach = light.farPlane + bounds[i].radius;
+      glm::vec3 offset = bounds[i].center - positionable.pos;
+      affected = glm::dot(offset, offset) <= reach * reach;
+    }
+    if (affected) {
+      light.invalidateShadow();
+    }
+  }
+}
+}
 
 void
 systems::updateLighting(std::shared_ptr<EntityRegistry> registry,
-                        Renderer* renderer)
+                        const std::vector<entt::entity>& changed,
+                        const std::vector<BoundingSphere>& previousBounds)
+{
+  std::vector<BoundingSphere> bounds = previousBounds;
+  std::vector<entt::entity> movedLights;
+  bool unbounded = false;
+  for (auto entity : changed) {
+    if (registry->all_of<Light>(entity)) {
+      movedLights.push_back(entity);
+    }
+    // only models are drawn into the depth maps
+    if (!registry->all_of<Model>(entity)) {
+      continue;
+    }
+    auto sphere = registry->try_get<BoundingSphere>(entity);
+    if (sphere != nullptr) {
+      bounds.push_back(*sphere);
+    } else {
+      unbounded = true;
+    }
+  }
+
+  invalidateLights(*registry, bounds, movedLights, unbounded);
+}
+
+void
+systems::forgetShadowCaster(EntityRegistry& registry, entt::entity entity)
+{
+  if (!registry.all_of<Model, Positionable>(entity)) {
+    return;
+  }
+  if (auto sphere = registry.try_get<BoundingSphere>(entity)) {
+    invalidateLights(registry, { *sphere }, {}, false);
+  } else {
+    invalidateLights(registry, {}, {}, true);
+  }
+}
+
+namespace {
+// which light holds each ShadowAtlas slot
+struct ShadowSlots
 {
+  std::vector<entt::entity> holders =
+    std::vector<entt::entity>(ShadowAtlas::SLOTS, entt::entity(entt::null));
+};
+
+// Hands the atlas slots to the lights whose shadows can cover the most of
+// the screen and picks each one's resolution. A light that gains a slot or
+// changes resolution needs its map redrawn.
+void
+assignShadowSlots(std::shared_ptr<EntityRegistry> registry, Camera* camera)
+{
+  auto& slots = registry->ctx().emplace<ShadowSlots>().holders;
+  auto frustum = camera->createFrustum();
+  auto view = registry->view<Light, Positionable>();
+  std::vector<ShadowCandidate> candidates;
+  for (auto [entity, light, positionable] : view.each()) {
+    BoundingSphere reach{ positionable.pos, light.farPlane };
+    bool visible = systems::isOnOrForwardPlane(&reach, frustum.leftFace) &&
+                   systems::isOnOrForwardPlane(&reach, frustum.rightFace) &&
+                   systems::isOnOrForwardPlane(&reach, frustum.topFace) &&
+                   systems::isOnOrForwardPlane(&reach, frustum.bottomFace) &&
+                   systems::isOnOrForwardPlane(&reach, frustum.nearFace) &&
+                   systems::isOnOrForwardPlane(&reach, frustum.farFace);
+    float distance = glm::distance(camera->position, positionable.pos);
+    float relevance = light.farPlane / std::max(distance, 1.0f);
+    // off-screen lights only get slots nobody visible wants
+    if (!visible) {
+      relevance *= 0.01f;
+    }
+    candidates.push_back({ entt::to_integral(entity), relevance });
+  }
+
+  std::vector<uint32_t> current;
+  for (auto entity : slots) {
+    current.push_back(entt::to_integral(entity));
+  }
+  auto assigned =
+    ::assignShadowSlots(current, std::move(candidates), ShadowAtlas::SLOTS);
+  for (int slot = 0; slot < assigned.size(); slot++) {
+    auto entity = entt::entity(assigned[slot]);
+    if (slots[slot] != entity && registry->valid(slots[slot])) {
+      if (auto light = registry->try_get<Light>(slots[slot])) {
+        light->shadowSlot = -1;
+        light->shadowMapped = false;
+      }
+    }
+    slots[slot] = entity;
+  }
+  for (int slot = 0; slot < slots.size(); slot++) {
+    if (slots[slot] == entt::null) {
+      continue;
+    }
+    auto [light, positionable] = view.get<Light, Positionable>(slots[slot]);
+    int resolution =
+      shadowResolution(glm::distance(camera->position, positionable.pos),
+                       light.farPlane,
+                       light.shadowSlot == slot ? light.shadowResolution : 0);
+    if (light.shadowSlot != slot) {
+      // a new slot has someone else's map in it
+      light.shadowMapped = false;
+      light.shadowSlot = slot;
+      light.shadowResolution = resolution;
+      light.invalidateShadow();
+    } else if (light.shadowResolution != resolution) {
+      // the old map stays sampled at its own scale until this one renders
+      light.shadowResolution = resolution;
+      light.invalidateShadow();
+    }
+  }
+}
+}
+
+void
+systems::renderShadowMaps(std::shared_ptr<EntityRegistry> registry,
+                          Renderer* renderer,
+                          double budgetSeconds)
+{
+  ZoneScoped;
+  assignShadowSlots(registry, renderer->getCamera());
+  std::vector<entt::entity> dirty;
   auto view = registry->view<Light, Positionable>();
   for (auto [entity, light, positionable] : view.each()) {
-    std::function<void()> render =
-      std::bind(&Renderer::render, renderer, LIGHT, entity);
-    light.renderDepthMap(positionable.pos, render);
+    if (light.shadowDirty && light.shadowSlot >= 0) {
+      dirty.push_back(entity);
+    }
+  }
+  if (dirty.empty()) {
+    return;
+  }
+  // oldest first, so a light that is invalidated every frame can't starve
+  // the others
+  std::sort(dirty.begin(), dirty.end(), [&](entt::entity a, entt::entity b) {
+    return view.get<Light>(a).dirtySince < view.get<Light>(b).dirtySince;
+  });
+
+  double deadline = nowSeconds() + budgetSeconds;
+  for (int i = 0; i < dirty.size(); i++) {
+    if (i > 0 && nowSeconds() >= deadline) {
+      break;
+    }
+    auto entity = dirty[i];
+    auto [light, positionable] = view.get<Light, Positionable>(entity);
+    light.renderDepthMap(
+      renderer->getShadowAtlas(), positionable.pos, [&](int face) {
+        renderer->render(LIGHT, entity, face);
+      });
   }
+  // The maps are sampled by the next camera pass. Lights left over by the
+  // budget get their turn in that frame, so an idle scene keeps going until
+  // none are dirty.
+  sceneDamage::mark();
 }
@@ -0,0 +1,27 @@
+#include "systems/ModelLoading.h"
+#include "model.h"
+#include "sceneDamage.h"
+#include "tracy/Tracy.hpp"
+#include <unordered_set>
+
+void
+systems::finishModelLoads(std::shared_ptr<EntityRegistry> registry,
+                          double budgetSeconds)
+{
+  ZoneScoped;
+  auto finished = ModelAssets::upload(budgetSeconds);
+  if (finished.empty()) {
+    return;
+  }
+  sceneDamage::mark();
+  std::unordered_set<ModelAsset*> ready;
+  for (auto& asset : finished) {
+    ready.insert(asset.get());
+  }
+  auto view = registry->view<Model, Positionable>();
+  for (auto [entity, model, positionable] : view.each()) {
+    if (ready.contains(&model.getAsset())) {
+      positionable.damage();
+    }
+  }
+}
@@ -0,0 +1,161 @@
+#include "systems/Scheduler.h"
+#include "time_utils.h"
+#include "tracy/Tracy.hpp"
+#include <algorithm>
+
+namespace systems {
+
+static bool
+overlaps(const std::vector<entt::id_type>& a,
+         const std::vector<entt::id_type>& b)
+{
+  for (auto id : a) {
+    if (std::find(b.begin(), b.end(), id) != b.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+Scheduler::conflicts(const ScheduledSystem& a, const ScheduledSystem& b) const
+{
+  return overlaps(a.writes, b.writes) || overlaps(a.writes, b.reads) ||
+         overlaps(a.reads, b.writes);
+}
+
+Scheduler::~Scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(workMutex);
+    stopping = true;
+  }
+  workReady.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void
+Scheduler::add(ScheduledSystem system)
+{
+  int later = systems.size();
+  dependents.emplace_back();
+  dependencyCount.push_back(0);
+  for (int earlier = 0; earlier < later; earlier++) {
+    if (conflicts(systems[earlier], system)) {
+      dependents[earlier].push_back(later);
+      dependencyCount[later]++;
+    }
+  }
+  systems.push_back(std::move(system));
+}
+
+const std::vector<ScheduledSystem>&
+Scheduler::getSystems() const
+{
+  return systems;
+}
+
+void
+Scheduler::run(ScheduledSystem& system)
+{
+  ZoneScoped;
+  ZoneName(system.name.c_str(), system.name.size());
+  double start = nowSeconds();
+  system.run();
+  system.lastMilliseconds = (nowSeconds() - start) * 1000.0;
+}
+
+void
+Scheduler::startWorkers(size_t wanted)
+{
+  // the calling thread always runs part of each wave itself
+  size_t limit = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  wanted = std::min(wanted, limit);
+  while (workers.size() < wanted) {
+    workers.emplace_back([this]() { work(); });
+  }
+}
+
+void
+Scheduler::work()
+{
+  std::unique_lock<std::mutex> lock(workMutex);
+  while (true) {
+    workReady.wait(lock, [this]() { return stopping || !queued.empty(); });
+    if (queued.empty()) {
+      return;
+    }
+    int i = queued.front();
+    queued.pop_front();
+    lock.unlock();
+    run(systems[i]);
+    lock.lock();
+    if (--unfinished == 0) {
+      workDone.notify_all();
+    }
+  }
+}
+
+void
+Scheduler::tick()
+{
+  ZoneScoped;
+  size_t count = systems.size();
+  std::vector<int> waitingOn = dependencyCount;
+
+  std::vector<int> ready;
+  for (int i = 0; i < count; i++) {
+    if (waitingOn[i] == 0) {
+      ready.push_back(i);
+    }
+  }
+
+  while (!ready.empty()) {
+    std::vector<int> wave;
+    wave.swap(ready);
+
+    // main-thread systems run here; if there are none, the first worker
+    // system does instead of idling while the others finish
+    bool keepOne = std::none_of(wave.begin(), wave.end(), [this](int i) {
+      return systems[i].mainThread;
+    });
+    std::vector<int> onThisThread;
+    std::vector<int> onWorkers;
+    for (auto i : wave) {
+      if (systems[i].mainThread || keepOne) {
+        onThisThread.push_back(i);
+        keepOne = false;
+      } else {
+        onWorkers.push_back(i);
+      }
+    }
+    if (!onWorkers.empty()) {
+      startWorkers(onWorkers.size());
+      {
+        std::lock_guard<std::mutex> lock(workMutex);
+        queued.insert(queued.end(), onWorkers.begin(), onWorkers.end());
+        unfinished += onWorkers.size();
+      }
+      workReady.notify_all();
+    }
+    for (auto i : onThisThread) {
+      run(systems[i]);
+    }
+    if (!onWorkers.empty()) {
+      std::unique_lock<std::mutex> lock(workMutex);
+      workDone.wait(lock, [this]() { return unfinished == 0; });
+    }
+
+    for (auto i : wave) {
+      for (auto dependent : dependents[i]) {
+        if (--waitingOn[dependent] == 0) {
+          ready.push_back(dependent);
+        }
+      }
+    }
+  }
+}
+
+}
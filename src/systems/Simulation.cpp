@@ -0,0 +1,59 @@
+#include "systems/Simulation.h"
+#include "components/RotateMovement.h"
+#include "components/TranslateMovement.h"
+#include "model.h"
+
+SimulatedTransform&
+systems::simulatedTransform(std::shared_ptr<EntityRegistry> registry,
+                            entt::entity entity)
+{
+  auto simulated = registry->try_get<SimulatedTransform>(entity);
+  if (simulated != nullptr) {
+    return *simulated;
+  }
+  auto& positionable = registry->get<Positionable>(entity);
+  glm::quat rotation(glm::radians(positionable.rotate));
+  return registry->emplace<SimulatedTransform>(entity,
+                                               positionable.pos,
+                                               positionable.pos,
+                                               rotation,
+                                               rotation,
+                                               positionable.pos,
+                                               rotation);
+}
+
+void
+systems::beginSimulationStep(std::shared_ptr<EntityRegistry> registry)
+{
+  auto view = registry->view<SimulatedTransform>();
+  for (auto [entity, simulated] : view.each()) {
+    simulated.previousPos = simulated.pos;
+    simulated.previousRotation = simulated.rotation;
+  }
+}
+
+void
+systems::presentSimulation(std::shared_ptr<EntityRegistry> registry,
+                           float alpha)
+{
+  std::vector<entt::entity> settled;
+  auto view = registry->view<Positionable, SimulatedTransform>();
+  for (auto [entity, positionable, simulated] : view.each()) {
+    bool moving = registry->any_of<TranslateMovement, RotateMovement>(entity);
+    float t = moving ? alpha : 1.0f;
+    glm::vec3 pos = glm::mix(simulated.previousPos, simulated.pos, t);
+    glm::quat rotation =
+      glm::slerp(simulated.previousRotation, simulated.rotation, t);
+    glm::quat turned = rotation * glm::inverse(simulated.presentedRotation);
+    positionable.pos += pos - simulated.presentedPos;
+    positionable.rotate = glm::degrees(glm::eulerAngles(glm::normalize(
+      turned * glm::quat(glm::radians(positionable.rotate)))));
+    simulated.presentedPos = pos;
+    simulated.presentedRotation = rotation;
+    positionable.damage();
+    if (!moving) {
+      settled.push_back(entity);
+    }
+  }
+  registry->remove<SimulatedTransform>(settled.begin(), settled.end());
+}
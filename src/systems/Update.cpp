@@ -1,28 +1,108 @@
 #include "systems/Update.h"
-#include "systems/ApplyRotation.h"
-#include "systems/ApplyTranslation.h"
+#include "systems/Hierarchy.h"
 #include "components/BoundingSphere.h"
 #include "model.h"
+#include "sceneDamage.h"
 #include "systems/Intersections.h"
 #include "systems/Light.h"
+#include "transformBatch.h"
+#include <glm/gtc/quaternion.hpp>
 
+namespace {
 void
-systems::updateAll(std::shared_ptr<EntityRegistry> registry, Renderer* renderer)
+bindDamageQueue(entt::registry& registry, entt::entity entity)
 {
-  bool updatedSomething = false;
-  auto view = registry->view<Positionable>();
-  for (auto [entity, positionable] : view.each()) {
-    if (positionable.damaged) {
-      systems::update(registry, entity);
-      updatedSomething = true;
-    }
+  auto& positionable = registry.get<Positionable>(entity);
+  positionable.entity = entity;
+  positionable.damageQueue =
+    &static_cast<EntityRegistry&>(registry).damageQueue();
+  positionable.queued = false;
+  // a freshly emplaced Positionable always needs one update pass
+  positionable.damage();
+}
+
+// A caster whose asset was already loaded isn't damaged by the load, so
+// lights only learn about it here.
+void
+damageCaster(entt::registry& registry, entt::entity entity)
+{
+  if (auto positionable = registry.try_get<Positionable>(entity)) {
+    positionable->damage();
   }
-  if (updatedSomething) {
-    systems::updateLighting(registry, renderer);
+}
+
+void
+forgetCaster(entt::registry& registry, entt::entity entity)
+{
+  systems::forgetShadowCaster(static_cast<EntityRegistry&>(registry), entity);
+}
+}
+
+void
+systems::trackDamage(std::shared_ptr<EntityRegistry> registry)
+{
+  registry->on_construct<Positionable>().connect<&bindDamageQueue>();
+  registry->on_update<Positionable>().connect<&bindDamageQueue>();
+  registry->on_construct<Model>().connect<&damageCaster>();
+  registry->on_destroy<Model>().connect<&forgetCaster>();
+  registry->on_destroy<Positionable>().connect<&forgetCaster>();
+}
+
+void
+systems::updateAll(std::shared_ptr<EntityRegistry> registry)
+{
+  auto& queue = registry->damageQueue();
+  auto& hierarchy = systems::transformHierarchy(registry);
+  for (auto entity : queue) {
+    hierarchy.markMoved(entity);
   }
+  // descendants of anything that moved get damaged, which queues them too
+  systems::propagateTransforms(registry);
 
-  systems::applyRotation(registry);
-  systems::applyTranslations(registry);
+  std::vector<entt::entity> changed;
+  changed.swap(queue);
+  if (!changed.empty()) {
+    sceneDamage::mark();
+  }
+  std::vector<entt::entity> updated;
+  std::vector<Positionable*> positionables;
+  std::vector<BoundingSphere> previousBounds;
+  TransformBatch batch;
+  for (auto entity : changed) {
+    if (!registry->valid(entity)) {
+      continue;
+    }
+    auto positionable = registry->try_get<Positionable>(entity);
+    if (positionable == nullptr) {
+      continue;
+    }
+    positionable->queued = false;
+    auto bounds = registry->try_get<BoundingSphere>(entity);
+    if (bounds != nullptr) {
+      previousBounds.push_back(*bounds);
+    }
+    batch.push(positionable->pos,
+               positionable->origin,
+               glm::quat(glm::radians(positionable->rotate)),
+               positionable->scale);
+    positionables.push_back(positionable);
+    updated.push_back(entity);
+  }
+
+  std::vector<glm::mat4> models(batch.size());
+  std::vector<glm::mat3> normals(batch.size());
+  computeTransforms(batch, models.data(), normals.data());
+  for (int i = 0; i < updated.size(); i++) {
+    positionables[i]->modelMatrix = models[i];
+    positionables[i]->normalMatrix = normals[i];
+    positionables[i]->damaged = false;
+    if (registry->all_of<BoundingSphere>(updated[i])) {
+      emplaceBoundingSphere(registry, updated[i]);
+    }
+  }
+  if (!updated.empty()) {
+    systems::updateLighting(registry, updated, previousBounds);
+  }
 }
 
 void
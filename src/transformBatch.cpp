@@ -0,0 +1,210 @@
+#include "transformBatch.h"
+#include <algorithm>
+#include <future>
+#include <thread>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// below this many transforms a worker thread costs more than it saves
+static const size_t PARALLEL_BATCH_THRESHOLD = 4096;
+
+void
+TransformBatch::clear()
+{
+  for (auto* column : { &px, &py, &pz, &ox, &oy, &oz, &qx, &qy, &qz, &qw,
+                        &scale }) {
+    column->clear();
+  }
+}
+
+void
+TransformBatch::push(glm::vec3 pos, glm::vec3 origin, glm::quat rotation, float s)
+{
+  px.push_back(pos.x);
+  py.push_back(pos.y);
+  pz.push_back(pos.z);
+  ox.push_back(origin.x);
+  oy.push_back(origin.y);
+  oz.push_back(origin.z);
+  qx.push_back(rotation.x);
+  qy.push_back(rotation.y);
+  qz.push_back(rotation.z);
+  qw.push_back(rotation.w);
+  scale.push_back(s);
+}
+
+size_t
+TransformBatch::size() const
+{
+  return px.size();
+}
+
+void
+composeTransform(glm::vec3 pos,
+                 glm::vec3 origin,
+                 glm::quat rotation,
+                 float scale,
+                 glm::mat4& model,
+                 glm::mat3& normal)
+{
+  glm::mat3 r = glm::mat3_cast(rotation);
+  glm::vec3 translation = pos - r * origin;
+  model[0] = glm::vec4(r[0] * scale, 0.0f);
+  model[1] = glm::vec4(r[1] * scale, 0.0f);
+  model[2] = glm::vec4(r[2] * scale, 0.0f);
+  model[3] = glm::vec4(translation, 1.0f);
+  normal = r * (1.0f / scale);
+}
+
+namespace {
+
+#if defined(__AVX__)
+typedef __m256 Lanes;
+constexpr size_t LANES = 8;
+inline Lanes load(const float* p) { return _mm256_loadu_ps(p); }
+inline Lanes splat(float v) { return _mm256_set1_ps(v); }
+inline void store(float* p, Lanes v) { _mm256_storeu_ps(p, v); }
+inline Lanes add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes quotient(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+#elif defined(__SSE2__)
+typedef __m128 Lanes;
+constexpr size_t LANES = 4;
+inline Lanes load(const float* p) { return _mm_loadu_ps(p); }
+inline Lanes splat(float v) { return _mm_set1_ps(v); }
+inline void store(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes quotient(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+#else
+constexpr size_t LANES = 1;
+#endif
+
+#if defined(__AVX__) || defined(__SSE2__)
+// Computes LANES transforms starting at i. Results are produced in SoA
+// registers and scattered into the glm matrices at the end.
+void
+computeLanes(const TransformBatch& b,
+             size_t i,
+             glm::mat4* model,
+             glm::mat3* normal)
+{
+  Lanes x = load(&b.qx[i]);
+  Lanes y = load(&b.qy[i]);
+  Lanes z = load(&b.qz[i]);
+  Lanes w = load(&b.qw[i]);
+  Lanes one = splat(1.0f);
+  Lanes two = splat(2.0f);
+
+  Lanes xx = mul(x, x), yy = mul(y, y), zz = mul(z, z);
+  Lanes xy = mul(x, y), xz = mul(x, z), yz = mul(y, z);
+  Lanes wx = mul(w, x), wy = mul(w, y), wz = mul(w, z);
+
+  // r<column><row>, matching glm::mat3_cast
+  Lanes r00 = sub(one, mul(two, add(yy, zz)));
+  Lanes r01 = mul(two, add(xy, wz));
+  Lanes r02 = mul(two, sub(xz, wy));
+  Lanes r10 = mul(two, sub(xy, wz));
+  Lanes r11 = sub(one, mul(two, add(xx, zz)));
+  Lanes r12 = mul(two, add(yz, wx));
+  Lanes r20 = mul(two, add(xz, wy));
+  Lanes r21 = mul(two, sub(yz, wx));
+  Lanes r22 = sub(one, mul(two, add(xx, yy)));
+
+  Lanes s = load(&b.scale[i]);
+  Lanes inv = quotient(one, s);
+  Lanes ox = load(&b.ox[i]);
+  Lanes oy = load(&b.oy[i]);
+  Lanes oz = load(&b.oz[i]);
+  Lanes tx =
+    sub(load(&b.px[i]), add(add(mul(r00, ox), mul(r10, oy)), mul(r20, oz)));
+  Lanes ty =
+    sub(load(&b.py[i]), add(add(mul(r01, ox), mul(r11, oy)), mul(r21, oz)));
+  Lanes tz =
+    sub(load(&b.pz[i]), add(add(mul(r02, ox), mul(r12, oy)), mul(r22, oz)));
+
+  Lanes rotation[9] = { r00, r01, r02, r10, r11, r12, r20, r21, r22 };
+  alignas(32) float m[9][LANES];
+  alignas(32) float n[9][LANES];
+  alignas(32) float t[3][LANES];
+  for (int k = 0; k < 9; k++) {
+    store(m[k], mul(rotation[k], s));
+    store(n[k], mul(rotation[k], inv));
+  }
+  store(t[0], tx);
+  store(t[1], ty);
+  store(t[2], tz);
+
+  for (size_t lane = 0; lane < LANES; lane++) {
+    glm::mat4& out = model[i + lane];
+    glm::mat3& outNormal = normal[i + lane];
+    for (int c = 0; c < 3; c++) {
+      out[c] = glm::vec4(
+        m[c * 3][lane], m[c * 3 + 1][lane], m[c * 3 + 2][lane], 0.0f);
+      outNormal[c] =
+        glm::vec3(n[c * 3][lane], n[c * 3 + 1][lane], n[c * 3 + 2][lane]);
+    }
+    out[3] = glm::vec4(t[0][lane], t[1][lane], t[2][lane], 1.0f);
+  }
+}
+#endif
+
+}
+
+void
+computeTransforms(const TransformBatch& batch,
+                  size_t begin,
+                  size_t end,
+                  glm::mat4* model,
+                  glm::mat3* normal)
+{
+  size_t i = begin;
+#if defined(__AVX__) || defined(__SSE2__)
+  for (; i + LANES <= end; i += LANES) {
+    computeLanes(batch, i, model, normal);
+  }
+#endif
+  for (; i < end; i++) {
+    composeTransform(
+      glm::vec3(batch.px[i], batch.py[i], batch.pz[i]),
+      glm::vec3(batch.ox[i], batch.oy[i], batch.oz[i]),
+      glm::quat(batch.qw[i], batch.qx[i], batch.qy[i], batch.qz[i]),
+      batch.scale[i],
+      model[i],
+      normal[i]);
+  }
+}
+
+void
+computeTransforms(const TransformBatch& batch,
+                  glm::mat4* model,
+                  glm::mat3* normal)
+{
+  size_t count = batch.size();
+  size_t workers = min<size_t>(thread::hardware_concurrency(),
+                               count / PARALLEL_BATCH_THRESHOLD);
+  if (workers <= 1) {
+    computeTransforms(batch, 0, count, model, normal);
+    return;
+  }
+
+  // keep every chunk boundary on a lane boundary
+  size_t chunk = (count / workers + LANES - 1) / LANES * LANES;
+  vector<future<void>> pending;
+  for (size_t begin = chunk; begin < count; begin += chunk) {
+    size_t end = min(begin + chunk, count);
+    pending.push_back(async(launch::async, [&batch, begin, end, model, normal]() {
+      computeTransforms(batch, begin, end, model, normal);
+    }));
+  }
+  computeTransforms(batch, 0, min(chunk, count), model, normal);
+  for (auto& work : pending) {
+    work.get();
+  }
+}
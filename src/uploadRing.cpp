@@ -0,0 +1,134 @@
+#include "uploadRing.h"
+
+namespace {
+
+// grow in whole megabytes so small size changes don't reallocate every time
+constexpr size_t GRANULARITY = 1 << 20;
+
+bool
+signaled(GLsync fence)
+{
+  GLenum state = glClientWaitSync(fence, 0, 0);
+  return state == GL_ALREADY_SIGNALED || state == GL_CONDITION_SATISFIED;
+}
+
+}
+
+bool
+UploadRing::init()
+{
+  if (initialized) {
+    return slots[0].buffer != 0;
+  }
+  initialized = true;
+  if (glMapBufferRange == nullptr || glFenceSync == nullptr) {
+    return false;
+  }
+  persistentMapping = glBufferStorage != nullptr;
+  for (auto& slot : slots) {
+    glGenBuffers(1, &slot.buffer);
+  }
+  return true;
+}
+
+bool
+UploadRing::reserve(Slot& slot, size_t bytes)
+{
+  if (slot.capacity >= bytes) {
+    return true;
+  }
+  size_t capacity = (bytes + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+  if (!persistentMapping) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    slot.capacity = capacity;
+    return true;
+  }
+
+  // immutable storage can't grow, so replace the buffer
+  glDeleteBuffers(1, &slot.buffer);
+  glGenBuffers(1, &slot.buffer);
+  slot.persistent = nullptr;
+  slot.capacity = 0;
+  const GLbitfield flags =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+  glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+  slot.persistent = static_cast<uint8_t*>(
+    glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (slot.persistent == nullptr) {
+    return false;
+  }
+  slot.capacity = capacity;
+  return true;
+}
+
+uint8_t*
+UploadRing::map(size_t bytes)
+{
+  if (bytes == 0 || !init()) {
+    return nullptr;
+  }
+  for (int tried = 0; tried < BUFFERS; tried++) {
+    int index = (next + tried) % BUFFERS;
+    Slot& slot = slots[index];
+    if (slot.fence) {
+      if (!signaled(slot.fence)) {
+        continue;
+      }
+      glDeleteSync(slot.fence);
+      slot.fence = nullptr;
+    }
+    if (!reserve(slot, bytes)) {
+      return nullptr;
+    }
+    uint8_t* pixels = slot.persistent;
+    if (!persistentMapping) {
+      // the fence already proved the GPU is done with the old contents
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+      pixels = static_cast<uint8_t*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                         0,
+                         bytes,
+                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                           GL_MAP_UNSYNCHRONIZED_BIT));
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    if (pixels == nullptr) {
+      return nullptr;
+    }
+    current = index;
+    next = (index + 1) % BUFFERS;
+    return pixels;
+  }
+  return nullptr;
+}
+
+bool
+UploadRing::bind()
+{
+  if (current < 0) {
+    return false;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slots[current].buffer);
+  // a false unmap means the contents were lost (e.g. a mode switch)
+  if (!persistentMapping && !glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    current = -1;
+    return false;
+  }
+  return true;
+}
+
+void
+UploadRing::release()
+{
+  if (current < 0) {
+    return;
+  }
+  slots[current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  current = -1;
+}
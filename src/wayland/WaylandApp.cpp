@@ -15,11 +15,16 @@ extern "C" {
 #include <wlr/xwayland.h>
 #undef class
 }
+#include <pixman-1/pixman.h>
 #include <signal.h>
 #include <unistd.h>
 #include <drm_fourcc.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include "screen.h"
+#include "appVisibility.h"
+#include "sceneDamage.h"
+#include "time_utils.h"
+#include "uploadRing.h"
 #include "components/Bootable.h"
 #include <cstdlib>
 #ifndef EGL_EGLEXT_PROTOTYPES
@@ -31,9 +36,14 @@ extern "C" {
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <glad/glad.h>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <future>
+#include <thread>
 #include <vector>
 
+#include "wayland/pixelConvert.h"
 #include "wayland/pointer.h"
 
 
@@ -64,6 +74,8 @@ using PFNGLEGLIMAGETARGETTEXTURE2DOESPROC =
 static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC gEGLImageTargetTexture2DOES = nullptr;
 static PFNEGLCREATEIMAGEKHRPROC gEglCreateImageKHR = nullptr;
 static PFNEGLDESTROYIMAGEKHRPROC gEglDestroyImageKHR = nullptr;
+// Shared by every app's CPU uploads; only touched on the render thread.
+static UploadRing gUploadRing;
 
 static void
 ensureEglImageFns()
@@ -78,6 +90,191 @@ ensureEglImageFns()
   }
 }
 
+// Past this many rectangles one upload of their bounding box is cheaper than
+// a glTexSubImage2D call per rectangle.
+static constexpr int MAX_DAMAGE_RECTS = 16;
+
+// Uploads a width x height image whose rows are `stride` bytes apart and
+// whose first row at `src` is texture row `originRow`. When the texture has
+// to be (re)allocated the whole image goes up, otherwise only the damaged
+// rectangles do, read straight out of the source rows. `src` is an offset
+// while a pixel-unpack buffer is bound. Returns the number of bytes handed
+// to GL.
+static size_t
+uploadPixels(GLenum format,
+             const uint8_t* src,
+             size_t stride,
+             int width,
+             int height,
+             int originRow,
+             pixman_region32_t* damage,
+             bool reallocate)
+{
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(stride / 4));
+  size_t uploaded = 0;
+  if (reallocate) {
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 GL_RGBA,
+                 width,
+                 height,
+                 0,
+                 format,
+                 GL_UNSIGNED_BYTE,
+                 src);
+    uploaded = static_cast<size_t>(width) * height * 4;
+  } else {
+    pixman_region32_intersect_rect(damage, damage, 0, 0, width, height);
+    int count = 0;
+    const pixman_box32_t* rects = pixman_region32_rectangles(damage, &count);
+    if (count > MAX_DAMAGE_RECTS) {
+      rects = pixman_region32_extents(damage);
+      count = 1;
+    }
+    for (int i = 0; i < count; ++i) {
+      const pixman_box32_t& rect = rects[i];
+      int rectWidth = rect.x2 - rect.x1;
+      int rectHeight = rect.y2 - rect.y1;
+      if (rectWidth <= 0 || rectHeight <= 0) {
+        continue;
+      }
+      glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x1);
+      glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y1 - originRow);
+      glTexSubImage2D(GL_TEXTURE_2D,
+                      0,
+                      rect.x1,
+                      rect.y1,
+                      rectWidth,
+                      rectHeight,
+                      format,
+                      GL_UNSIGNED_BYTE,
+                      src);
+      uploaded += static_cast<size_t>(rectWidth) * rectHeight * 4;
+    }
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+  }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  return uploaded;
+}
+
+// Below this many bytes per worker, spreading a staging copy over threads
+// costs more than it saves.
+static constexpr size_t PARALLEL_STAGING_BYTES = 2 << 20;
+
+// Copies rows [firstRow, lastRow) of a client buffer into tightly packed
+// rows at dst, converting them to RGBA8 when `convert` is set. Large copies
+// are split into bands across worker threads.
+static void
+stageRows(const uint8_t* src,
+          size_t srcStride,
+          uint8_t* dst,
+          int width,
+          int firstRow,
+          int lastRow,
+          RowConverter convert)
+{
+  const size_t dstStride = static_cast<size_t>(width) * 4;
+  auto copyBand = [=](int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+      uint8_t* out = dst + static_cast<size_t>(y - firstRow) * dstStride;
+      if (convert) {
+        convert(src + y * srcStride, out, width);
+      } else {
+        memcpy(out, src + y * srcStride, dstStride);
+      }
+    }
+  };
+  int rows = lastRow - firstRow;
+  size_t workers = std::min<size_t>(
+    std::thread::hardware_concurrency(), rows * dstStride / PARALLEL_STAGING_BYTES);
+  if (workers <= 1) {
+    copyBand(firstRow, lastRow);
+    return;
+  }
+  int band = static_cast<int>((rows + workers - 1) / workers);
+  std::vector<std::future<void>> pending;
+  for (int begin = firstRow + band; begin < lastRow; begin += band) {
+    pending.push_back(std::async(
+      std::launch::async, copyBand, begin, std::min(begin + band, lastRow)));
+  }
+  copyBand(firstRow, std::min(firstRow + band, lastRow));
+  for (auto& work : pending) {
+    work.get();
+  }
+}
+
+#ifndef NDEBUG
+// Clients that commit colour with zero alpha would come out invisible; debug
+// builds force them opaque so the rendering path can be checked.
+static void
+forceOpaqueIfInvisible(uint8_t* rgba, size_t bytes)
+{
+  uint8_t minA = 255;
+  uint8_t anyColor = 0;
+  for (size_t i = 0; i < bytes; i += 4) {
+    minA = std::min(minA, rgba[i + 3]);
+    anyColor |= rgba[i + 0] | rgba[i + 1] | rgba[i + 2];
+  }
+  if (minA == 0 && anyColor != 0) {
+    for (size_t i = 0; i < bytes; i += 4) {
+      rgba[i + 3] = 255;
+    }
+  }
+}
+#endif
+
+// GL format that takes a 32-bit DRM format without swizzling, or 0 when the
+// buffer has to be converted.
+static GLenum
+directUploadFormat(uint32_t format, size_t stride)
+{
+  if (stride % 4 != 0) {
+    return 0;
+  }
+  GLenum glFormat = 0;
+  switch (format) {
+    case DRM_FORMAT_ARGB8888: // memory: B G R A
+      glFormat = GL_BGRA;
+      break;
+    case DRM_FORMAT_ABGR8888: // memory: R G B A
+      glFormat = GL_RGBA;
+      break;
+    case DRM_FORMAT_XRGB8888: // memory: B G R X (opaque)
+      glFormat = GL_BGRA;
+      break;
+    case DRM_FORMAT_XBGR8888: // memory: R G B X (opaque)
+      glFormat = GL_RGBA;
+      break;
+    default:
+      return 0;
+  }
+  // Ensure BGRA is supported before issuing the upload; otherwise fall back
+  // to the conversion path to avoid undefined behaviour on drivers lacking
+  // the extension.
+  bool bgraSupported = false;
+#ifdef GLAD_GL_EXT_texture_format_BGRA8888
+  bgraSupported = bgraSupported || GLAD_GL_EXT_texture_format_BGRA8888;
+#endif
+#ifdef GLAD_GL_APPLE_texture_format_BGRA8888
+  bgraSupported = bgraSupported || GLAD_GL_APPLE_texture_format_BGRA8888;
+#endif
+#ifdef GLAD_GL_EXT_read_format_bgra
+  bgraSupported = bgraSupported || GLAD_GL_EXT_read_format_bgra;
+#endif
+#ifdef GLAD_GL_IMG_read_format
+  bgraSupported = bgraSupported || GLAD_GL_IMG_read_format;
+#endif
+#ifdef GLAD_GL_OES_required_internalformat
+  bgraSupported = bgraSupported || GLAD_GL_OES_required_internalformat;
+#endif
+  if (glFormat == GL_BGRA && !bgraSupported) {
+    return 0;
+  }
+  return glFormat;
+}
+
 WaylandApp::WaylandApp(wlr_renderer* renderer,
                        wlr_allocator* allocator,
                        wlr_xdg_surface* xdg,
@@ -102,6 +299,8 @@ WaylandApp::WaylandApp(wlr_renderer* renderer,
     requestSize(width, height);
   }
 
+  pixman_region32_init(&damage);
+
   surface_commit.notify = [](wl_listener* listener, void* data) {
     auto* self = wl_container_of(listener, static_cast<WaylandApp*>(nullptr), surface_commit);
     self->handle_commit(static_cast<wlr_surface*>(data));
@@ -141,6 +340,8 @@ WaylandApp::WaylandApp(wlr_renderer* renderer,
   }
   update_height_scalar();
 
+  pixman_region32_init(&damage);
+
   surface_commit.notify = [](wl_listener* listener, void* data) {
     auto* self = wl_container_of(listener, static_cast<WaylandApp*>(nullptr), surface_commit);
     self->handle_commit(static_cast<wlr_surface*>(data));
@@ -174,6 +375,7 @@ WaylandApp::~WaylandApp()
   if (pending_buffer.has_value()) {
     wlr_buffer_unlock(pending_buffer.value());
   }
+  pixman_region32_fini(&damage);
 }
 
 void WaylandApp::unfocus() {
@@ -323,11 +525,62 @@ WaylandApp::handle_commit(wlr_surface* surface)
   pending_buffer = buf;
   sampleLogged = false;
   needsImport = true;
+  // Several commits can land between two uploads, so keep their union.
+  pixman_region32_union(&damage, &damage, &surface->buffer_damage);
 
   width = surface->current.width;
   height = surface->current.height;
+  if (lodLevel == 0) {
+    fullWidth = width;
+    fullHeight = height;
+  }
   update_height_scalar();
   mapped = true;
+  latency.committed(nowSeconds(), visible);
+  // hidden apps are imported once they're back in view
+  if (visible) {
+    sceneDamage::mark();
+  }
+}
+
+void
+WaylandApp::setProjectedPixels(float pixels)
+{
+  projectedPixels = pixels;
+  visible = pixels >= MIN_VISIBLE_PIXELS;
+}
+
+bool
+WaylandApp::frameDoneDue(double now)
+{
+  if (!visible && now - lastFrameDone < HIDDEN_FRAME_INTERVAL) {
+    return false;
+  }
+  lastFrameDone = now;
+  return true;
+}
+
+void
+WaylandApp::updateResolutionLod(bool focused, double now)
+{
+  if ((!xdg_toplevel && !xwayland_surface) || fullWidth <= 0 ||
+      fullHeight <= 0) {
+    return;
+  }
+  int level = 0;
+  if (!focused) {
+    if (!visible || now - lastLodChange < LOD_CHANGE_INTERVAL) {
+      return;
+    }
+    level = resolutionLodLevel(lodLevel, projectedPixels, fullWidth, fullHeight);
+  }
+  if (level == lodLevel) {
+    return;
+  }
+  lodLevel = level;
+  lastLodChange = now;
+  // halving both axes keeps the aspect ratio, so the quad doesn't change
+  requestSize(std::max(1, fullWidth >> level), std::max(1, fullHeight >> level));
 }
 
 void
@@ -467,6 +720,10 @@ WaylandApp::appTexture()
           uploadedWidth = width;
           uploadedHeight = height;
           needsImport = false;
+          // the texture now aliases the client's buffer
+          textureAllocated = false;
+          pixman_region32_clear(&damage);
+          latency.imported(nowSeconds());
           return;
         }
         if (gEglDestroyImageKHR) {
@@ -526,280 +783,19 @@ WaylandApp::appTexture()
     return;
   }
 
-  // Fast path: directly upload all common 32-bit formats without swizzle when
-  // stride matches. This avoids per-pixel conversion for repaint-heavy apps.
-  auto try_direct_upload = [&]() -> bool {
-    if (width <= 0 || height <= 0) {
-      return false;
-    }
-    if (srcStride != static_cast<size_t>(width) * 4) {
-      return false;
-    }
-    GLenum glFormat = 0;
-    switch (format) {
-      case DRM_FORMAT_ARGB8888: // memory: B G R A
-        glFormat = GL_BGRA;
-        break;
-      case DRM_FORMAT_ABGR8888: // memory: R G B A
-        glFormat = GL_RGBA;
-        break;
-      case DRM_FORMAT_XRGB8888: // memory: B G R X (opaque)
-        glFormat = GL_BGRA;
-        break;
-      case DRM_FORMAT_XBGR8888: // memory: R G B X (opaque)
-        glFormat = GL_RGBA;
-        break;
-      default:
-        return false;
-    }
-    // Ensure BGRA is supported before issuing the upload; otherwise fall back
-    // to the conversion path to avoid undefined behaviour on drivers lacking
-    // the extension.
-    bool bgraSupported = false;
-#ifdef GLAD_GL_EXT_texture_format_BGRA8888
-    bgraSupported = bgraSupported || GLAD_GL_EXT_texture_format_BGRA8888;
-#endif
-#ifdef GLAD_GL_APPLE_texture_format_BGRA8888
-    bgraSupported = bgraSupported || GLAD_GL_APPLE_texture_format_BGRA8888;
-#endif
-#ifdef GLAD_GL_EXT_read_format_bgra
-    bgraSupported = bgraSupported || GLAD_GL_EXT_read_format_bgra;
-#endif
-#ifdef GLAD_GL_IMG_read_format
-    bgraSupported = bgraSupported || GLAD_GL_IMG_read_format;
-#endif
-#ifdef GLAD_GL_OES_required_internalformat
-    bgraSupported = bgraSupported || GLAD_GL_OES_required_internalformat;
-#endif
-    if (glFormat == GL_BGRA && !bgraSupported) {
-      return false;
-    }
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_RGBA,
-                 width,
-                 height,
-                 0,
-                 glFormat,
-                 GL_UNSIGNED_BYTE,
-                 src);
-    uploadedWidth = width;
-    uploadedHeight = height;
-    GLenum errAfter = glGetError();
-    needsImport = false;
+  if (width <= 0 || height <= 0 ||
+      srcStride < static_cast<size_t>(width) * 4) {
     if (beganDataPtrAccess) {
       wlr_buffer_end_data_ptr_access(buffer);
     }
-    importedBuffer = buffer;
-    return errAfter == GL_NO_ERROR;
-  };
-  if (try_direct_upload()) {
     return;
   }
 
-  // Convert to RGBA8 if the format isn't directly supported in GLES2.
-  std::vector<uint8_t> converted;
-  const size_t dstStride = static_cast<size_t>(width) * 4;
-  GLenum uploadFormat = GL_RGBA;
-  uint32_t firstPixel = 0;
-  uint32_t rawFirstBytes = 0;
-  uint32_t centerPixel = 0;
-  uint32_t rawCenterBytes = 0;
-  uint32_t rowChecksum = 0;
-  // If the buffer appears to be empty, populate a test pattern to verify
-  // the rendering path. This will be used only for diagnostics.
-  bool injectTestPattern = false;
-  uint8_t minR = 255, minG = 255, minB = 255, minA = 255;
-  uint8_t maxR = 0, maxG = 0, maxB = 0, maxA = 0;
-
-  auto convert_row = [&](int y, uint8_t* dstRow) {
-    const uint8_t* srcRow = src + y * srcStride;
-    for (int x = 0; x < width; ++x) {
-      const uint8_t* p = srcRow + x * 4;
-      uint8_t r = 0, g = 0, b = 0, a = 0;
-      switch (format) {
-        case DRM_FORMAT_ARGB8888: // memory order (little-endian): B G R A
-          b = p[0];
-          g = p[1];
-          r = p[2];
-          a = p[3];
-          break;
-        case DRM_FORMAT_ABGR8888: // A B G R
-          r = p[0];
-          g = p[1];
-          b = p[2];
-          a = p[3];
-          break;
-        case DRM_FORMAT_BGRA8888: // memory order: A R G B
-          a = p[0];
-          r = p[1];
-          g = p[2];
-          b = p[3];
-          break;
-        case DRM_FORMAT_RGBA8888: // memory order: A B G R
-          a = p[0];
-          b = p[1];
-          g = p[2];
-          r = p[3];
-          break;
-        case DRM_FORMAT_XBGR8888: // memory order: R G B X
-          r = p[0];
-          g = p[1];
-          b = p[2];
-          a = 255;
-          break;
-        case DRM_FORMAT_BGRX8888: // memory order: X R G B
-          r = p[1];
-          g = p[2];
-          b = p[3];
-          a = 255;
-          break;
-        case DRM_FORMAT_RGBX8888: // memory order: X B G R
-          b = p[1];
-          g = p[2];
-          r = p[3];
-          a = 255;
-          break;
-        case DRM_FORMAT_XRGB8888: // Fourcc XRGB8888, bytes in memory B,G,R,X (little endian)
-          b = p[0];
-          g = p[1];
-          r = p[2];
-          a = 255;
-          break;
-        case DRM_FORMAT_XRGB2101010: { // 10:10:10:2 little endian, B,G,R,X
-          uint32_t v = *reinterpret_cast<const uint32_t*>(p);
-          uint32_t br = (v >> 0) & 0x3FF;
-          uint32_t bg = (v >> 10) & 0x3FF;
-          uint32_t bb = (v >> 20) & 0x3FF;
-          r = (uint8_t)((br * 255) / 1023);
-          g = (uint8_t)((bg * 255) / 1023);
-          b = (uint8_t)((bb * 255) / 1023);
-          a = 255;
-          break;
-        }
-        case DRM_FORMAT_XBGR2101010: { // B,G,R,X 10-bit
-          uint32_t v = *reinterpret_cast<const uint32_t*>(p);
-          uint32_t br = (v >> 0) & 0x3FF;
-          uint32_t bg = (v >> 10) & 0x3FF;
-          uint32_t bb = (v >> 20) & 0x3FF;
-          r = (uint8_t)((br * 255) / 1023);
-          g = (uint8_t)((bg * 255) / 1023);
-          b = (uint8_t)((bb * 255) / 1023);
-          a = 255;
-          break;
-        }
-        case DRM_FORMAT_ARGB2101010: { // B,G,R,A 10-bit with 2-bit alpha
-          uint32_t v = *reinterpret_cast<const uint32_t*>(p);
-          uint32_t br = (v >> 0) & 0x3FF;
-          uint32_t bg = (v >> 10) & 0x3FF;
-          uint32_t bb = (v >> 20) & 0x3FF;
-          uint32_t ba = (v >> 30) & 0x3;
-          r = (uint8_t)((br * 255) / 1023);
-          g = (uint8_t)((bg * 255) / 1023);
-          b = (uint8_t)((bb * 255) / 1023);
-          a = (uint8_t)((ba * 255) / 3);
-          break;
-        }
-        case DRM_FORMAT_ABGR2101010: { // R,G,B,A 10-bit with 2-bit alpha
-          uint32_t v = *reinterpret_cast<const uint32_t*>(p);
-          uint32_t br = (v >> 0) & 0x3FF;
-          uint32_t bg = (v >> 10) & 0x3FF;
-          uint32_t bb = (v >> 20) & 0x3FF;
-          uint32_t ba = (v >> 30) & 0x3;
-          b = (uint8_t)((br * 255) / 1023);
-          g = (uint8_t)((bg * 255) / 1023);
-          r = (uint8_t)((bb * 255) / 1023);
-          a = (uint8_t)((ba * 255) / 3);
-          break;
-        }
-        default:
-          // Assume RGBA
-          r = p[0];
-          g = p[1];
-          b = p[2];
-          a = p[3];
-          break;
-      }
-      dstRow[x * 4 + 0] = r;
-      dstRow[x * 4 + 1] = g;
-      dstRow[x * 4 + 2] = b;
-      dstRow[x * 4 + 3] = a;
-      if (y == 0 && x == 0) {
-        firstPixel = (uint32_t(r) << 24) | (uint32_t(g) << 16) |
-                     (uint32_t(b) << 8) | uint32_t(a);
-      }
-      minR = std::min(minR, r);
-      minG = std::min(minG, g);
-      minB = std::min(minB, b);
-      minA = std::min(minA, a);
-      maxR = std::max(maxR, r);
-      maxG = std::max(maxG, g);
-      maxB = std::max(maxB, b);
-      maxA = std::max(maxA, a);
-    }
-  };
-
-  converted.resize(static_cast<size_t>(height) * dstStride);
-  for (int y = 0; y < height; ++y) {
-    const uint8_t* row = src + y * srcStride;
-    if (y == 0 && width > 0) {
-      // Log the raw first pixel bytes before conversion for debugging.
-      rawFirstBytes = (uint32_t(row[0]) << 24) | (uint32_t(row[1]) << 16) |
-                      (uint32_t(row[2]) << 8) | uint32_t(row[3]);
-      // Simple checksum of first row
-      for (int x = 0; x < width; ++x) {
-        rowChecksum += row[x * 4 + 0] + row[x * 4 + 1] +
-                       row[x * 4 + 2] + row[x * 4 + 3];
-      }
-    }
-    if (y == height / 2 && width > 0) {
-      const uint8_t* p = row + (width / 2) * 4;
-      rawCenterBytes = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
-                       (uint32_t(p[2]) << 8) | uint32_t(p[3]);
-    }
-    uint8_t* dstRow = converted.data() + y * dstStride;
-    convert_row(y, dstRow);
-    if (injectTestPattern) {
-      for (int x = 0; x < width; ++x) {
-        dstRow[x * 4 + 0] = static_cast<uint8_t>((x * 255) / std::max(1, width - 1));
-        dstRow[x * 4 + 1] = static_cast<uint8_t>((y * 255) / std::max(1, height - 1));
-        dstRow[x * 4 + 2] = 128;
-        dstRow[x * 4 + 3] = 255;
-      }
-    }
-    if (y == height / 2 && width > 0) {
-      const uint8_t* dst = converted.data() + y * dstStride + (width / 2) * 4;
-      centerPixel = (uint32_t(dst[0]) << 24) | (uint32_t(dst[1]) << 16) |
-                    (uint32_t(dst[2]) << 8) | uint32_t(dst[3]);
-    }
-  }
-
-  bool forceOpaque = ((maxA == 0 || minA == 0) && (maxR | maxG | maxB));
-  if (forceOpaque) {
-    for (int y = 0; y < height; ++y) {
-      uint8_t* row = converted.data() + y * dstStride;
-      for (int x = 0; x < width; ++x) {
-        row[x * 4 + 3] = 255;
-      }
-    }
-    if (centerPixel != 0 && firstPixel == 0) {
-      firstPixel = centerPixel;
-    }
-    if (firstPixel != 0) {
-      firstPixel |= 0x000000FF;
-    }
-    if (centerPixel != 0) {
-      centerPixel |= 0x000000FF;
-    }
-    maxA = 255;
-  }
+  // Only damaged rectangles need uploading while the texture keeps the
+  // previous frame at the same size.
+  bool reallocate =
+    !textureAllocated || uploadedWidth != width || uploadedHeight != height;
+  pixman_region32_intersect_rect(&damage, &damage, 0, 0, width, height);
 
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, textureId);
@@ -811,36 +807,74 @@ WaylandApp::appTexture()
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glTexImage2D(GL_TEXTURE_2D,
-               0,
-               GL_RGBA,
-               width,
-               height,
-               0,
-               GL_RGBA,
-               GL_UNSIGNED_BYTE,
-               converted.data());
+
+  // Stages the damaged rows through the upload ring and sources the texture
+  // update from there. With no staging buffer free it falls back to
+  // uploading from client memory (converting first when `convert` is set).
+  auto upload = [&](GLenum glFormat, RowConverter convert) -> bool {
+    // Rows outside the damage keep last frame's texels, so skip them.
+    int firstRow = 0;
+    int lastRow = height;
+    if (!reallocate) {
+      const pixman_box32_t* extents = pixman_region32_extents(&damage);
+      bool damaged = pixman_region32_not_empty(&damage);
+      firstRow = damaged ? extents->y1 : 0;
+      lastRow = damaged ? extents->y2 : 0;
+    }
+    const size_t dstStride = static_cast<size_t>(width) * 4;
+    const size_t stagedBytes = static_cast<size_t>(lastRow - firstRow) * dstStride;
+    auto stage = [&](uint8_t* dst) {
+      stageRows(src, srcStride, dst, width, firstRow, lastRow, convert);
+#ifndef NDEBUG
+      if (convert) {
+        forceOpaqueIfInvisible(dst, stagedBytes);
+      }
+#endif
+    };
+
+    if (uint8_t* staging = gUploadRing.map(stagedBytes)) {
+      stage(staging);
+      if (gUploadRing.bind()) {
+        uploadPixels(
+          glFormat, nullptr, dstStride, width, height, firstRow, &damage, reallocate);
+        gUploadRing.release();
+        return glGetError() == GL_NO_ERROR;
+      }
+    }
+    if (!convert) {
+      uploadPixels(glFormat, src, srcStride, width, height, 0, &damage, reallocate);
+    } else {
+      converted.resize(stagedBytes);
+      stage(converted.data());
+      uploadPixels(glFormat,
+                   converted.data(),
+                   dstStride,
+                   width,
+                   height,
+                   firstRow,
+                   &damage,
+                   reallocate);
+    }
+    return glGetError() == GL_NO_ERROR;
+  };
+
+  // Common 32-bit formats upload without swizzle, which avoids per-pixel
+  // conversion for repaint-heavy apps. Everything else, or a driver that
+  // rejects the direct format, is converted to RGBA8 by a converter picked
+  // once per buffer.
+  GLenum directFormat = directUploadFormat(format, srcStride);
+  bool uploaded = directFormat != 0 && upload(directFormat, nullptr);
+  if (!uploaded) {
+    reallocate = true;
+    uploaded = upload(GL_RGBA, rowConverterFor(format));
+  }
   uploadedWidth = width;
   uploadedHeight = height;
-  GLenum errAfter = glGetError();
-  if (rowChecksum == 0 && centerPixel == 0 && firstPixel == 0) {
-    injectTestPattern = true;
-  }
-  if (injectTestPattern) {
-    glTexSubImage2D(GL_TEXTURE_2D,
-                    0,
-                    0,
-                    0,
-                    width,
-                    height,
-                    uploadFormat,
-                    GL_UNSIGNED_BYTE,
-                    converted.data());
-    errAfter = glGetError();
-  }
+  textureAllocated = uploaded;
+  pixman_region32_clear(&damage);
   importedBuffer = buffer;
   needsImport = false;
+  latency.imported(nowSeconds());
   if (beganDataPtrAccess) {
     wlr_buffer_end_data_ptr_access(buffer);
   }
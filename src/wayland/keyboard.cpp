@@ -7,6 +7,7 @@ extern "C" {
 
 #include "wayland/keyboard.h"
 #include "wayland/wlr_compositor.h"
+#include "sceneDamage.h"
 
 
 
@@ -83,6 +84,7 @@ handle_keyboard_key(wl_listener* listener, void* data)
     wl_container_of(listener, static_cast<WlrKeyboardHandle*>(nullptr), key);
   auto* server = handle->server;
   auto* event = static_cast<wlr_keyboard_key_event*>(data);
+  sceneDamage::mark();
   // wlroots key events carry a hardware/libinput keycode. Add 8 only for xkb
   // lookup; keep the raw code for notifying the seat.
   uint32_t xkb_keycode = event->keycode + 8;
@@ -0,0 +1,177 @@
+#include "wayland/pixelConvert.h"
+#include <drm_fourcc.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#if defined(__AVX2__)
+typedef __m256i Pixels;
+constexpr int PIXELS = 8;
+inline Pixels load(const uint8_t* p)
+{
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+inline void store(uint8_t* p, Pixels v)
+{
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+inline Pixels splat(uint32_t v) { return _mm256_set1_epi32(int(v)); }
+inline Pixels bitAnd(Pixels a, Pixels b) { return _mm256_and_si256(a, b); }
+inline Pixels bitOr(Pixels a, Pixels b) { return _mm256_or_si256(a, b); }
+inline Pixels shiftRight(Pixels v, int n) { return _mm256_srli_epi32(v, n); }
+inline Pixels shiftLeft(Pixels v, int n) { return _mm256_slli_epi32(v, n); }
+inline Pixels mulHigh16(Pixels a, Pixels b) { return _mm256_mulhi_epu16(a, b); }
+inline Pixels mulLow16(Pixels a, Pixels b) { return _mm256_mullo_epi16(a, b); }
+// the byte shuffle stays within each 16 byte half, which holds whole pixels
+inline Pixels shuffleBytes(Pixels v, __m128i mask)
+{
+  return _mm256_shuffle_epi8(v, _mm256_broadcastsi128_si256(mask));
+}
+#define HAVE_BYTE_SHUFFLE
+#elif defined(__SSE2__)
+typedef __m128i Pixels;
+constexpr int PIXELS = 4;
+inline Pixels load(const uint8_t* p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline void store(uint8_t* p, Pixels v)
+{
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+inline Pixels splat(uint32_t v) { return _mm_set1_epi32(int(v)); }
+inline Pixels bitAnd(Pixels a, Pixels b) { return _mm_and_si128(a, b); }
+inline Pixels bitOr(Pixels a, Pixels b) { return _mm_or_si128(a, b); }
+inline Pixels shiftRight(Pixels v, int n) { return _mm_srli_epi32(v, n); }
+inline Pixels shiftLeft(Pixels v, int n) { return _mm_slli_epi32(v, n); }
+inline Pixels mulHigh16(Pixels a, Pixels b) { return _mm_mulhi_epu16(a, b); }
+inline Pixels mulLow16(Pixels a, Pixels b) { return _mm_mullo_epi16(a, b); }
+#if defined(__SSSE3__)
+inline Pixels shuffleBytes(Pixels v, __m128i mask)
+{
+  return _mm_shuffle_epi8(v, mask);
+}
+#define HAVE_BYTE_SHUFFLE
+#endif
+#endif
+
+// Source byte offsets of R, G, B and A within a pixel; A < 0 means the
+// format has no alpha and the output is opaque.
+template<int R, int G, int B, int A>
+void
+swizzleRow(const uint8_t* src, uint8_t* dst, int width)
+{
+  int x = 0;
+#if defined(HAVE_BYTE_SHUFFLE)
+  // pshufb writes zero for indices with the top bit set
+  auto lane = [](int pixel, int offset) {
+    return char(offset < 0 ? 0x80 : pixel * 4 + offset);
+  };
+  const __m128i mask = _mm_setr_epi8(lane(0, R), lane(0, G), lane(0, B), lane(0, A),
+                                     lane(1, R), lane(1, G), lane(1, B), lane(1, A),
+                                     lane(2, R), lane(2, G), lane(2, B), lane(2, A),
+                                     lane(3, R), lane(3, G), lane(3, B), lane(3, A));
+  const Pixels opaque = splat(A < 0 ? 0xFF000000u : 0u);
+  for (; x + PIXELS <= width; x += PIXELS) {
+    Pixels p = load(src + x * 4);
+    store(dst + x * 4, bitOr(shuffleBytes(p, mask), opaque));
+  }
+#endif
+  for (; x < width; ++x) {
+    const uint8_t* p = src + x * 4;
+    uint8_t* out = dst + x * 4;
+    out[0] = p[R];
+    out[1] = p[G];
+    out[2] = p[B];
+    out[3] = A < 0 ? 255 : p[A < 0 ? 0 : A];
+  }
+}
+
+// 10 bit channel to 8 bits, equal to v * 255 / 1023 for every v in [0, 1023]
+inline uint32_t
+channel10To8(uint32_t v)
+{
+  return (v * 16336) >> 16;
+}
+
+// Little-endian 2:10:10:10 words. RedLow puts red in bits 0-9 (the xBGR
+// formats); otherwise blue is there (the xRGB formats).
+template<bool RedLow, bool HasAlpha>
+void
+unpack2101010Row(const uint8_t* src, uint8_t* dst, int width)
+{
+  int x = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+  const Pixels tenBits = splat(0x3FF);
+  // 32 bit lanes hold values below 2^16, so the 16 bit multiplies only ever
+  // see zeros in the upper halves
+  const Pixels scale = splat(16336);
+  const Pixels alphaScale = splat(85);
+  const Pixels opaque = splat(0xFF000000u);
+  for (; x + PIXELS <= width; x += PIXELS) {
+    Pixels v = load(src + x * 4);
+    Pixels low = mulHigh16(bitAnd(v, tenBits), scale);
+    Pixels green = mulHigh16(bitAnd(shiftRight(v, 10), tenBits), scale);
+    Pixels high = mulHigh16(bitAnd(shiftRight(v, 20), tenBits), scale);
+    Pixels red = RedLow ? low : high;
+    Pixels blue = RedLow ? high : low;
+    Pixels alpha = HasAlpha
+                     ? shiftLeft(mulLow16(shiftRight(v, 30), alphaScale), 24)
+                     : opaque;
+    Pixels rgba = bitOr(bitOr(red, shiftLeft(green, 8)),
+                        bitOr(shiftLeft(blue, 16), alpha));
+    store(dst + x * 4, rgba);
+  }
+#endif
+  for (; x < width; ++x) {
+    const uint8_t* p = src + x * 4;
+    uint32_t v = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+                 uint32_t(p[3]) << 24;
+    uint32_t low = channel10To8(v & 0x3FF);
+    uint32_t high = channel10To8((v >> 20) & 0x3FF);
+    uint8_t* out = dst + x * 4;
+    out[0] = RedLow ? low : high;
+    out[1] = channel10To8((v >> 10) & 0x3FF);
+    out[2] = RedLow ? high : low;
+    out[3] = HasAlpha ? (v >> 30) * 85 : 255;
+  }
+}
+
+}
+
+RowConverter
+rowConverterFor(uint32_t drmFormat)
+{
+  // byte offsets are for the little-endian memory order of each fourcc
+  switch (drmFormat) {
+    case DRM_FORMAT_ARGB8888: // B G R A
+      return swizzleRow<2, 1, 0, 3>;
+    case DRM_FORMAT_XRGB8888: // B G R X
+      return swizzleRow<2, 1, 0, -1>;
+    case DRM_FORMAT_ABGR8888: // R G B A
+      return swizzleRow<0, 1, 2, 3>;
+    case DRM_FORMAT_XBGR8888: // R G B X
+      return swizzleRow<0, 1, 2, -1>;
+    case DRM_FORMAT_BGRA8888: // A R G B
+      return swizzleRow<1, 2, 3, 0>;
+    case DRM_FORMAT_BGRX8888: // X R G B
+      return swizzleRow<1, 2, 3, -1>;
+    case DRM_FORMAT_RGBA8888: // A B G R
+      return swizzleRow<3, 2, 1, 0>;
+    case DRM_FORMAT_RGBX8888: // X B G R
+      return swizzleRow<3, 2, 1, -1>;
+    case DRM_FORMAT_ARGB2101010:
+      return unpack2101010Row<false, true>;
+    case DRM_FORMAT_XRGB2101010:
+      return unpack2101010Row<false, false>;
+    case DRM_FORMAT_ABGR2101010:
+      return unpack2101010Row<true, true>;
+    case DRM_FORMAT_XBGR2101010:
+      return unpack2101010Row<true, false>;
+    default:
+      return swizzleRow<0, 1, 2, 3>;
+  }
+}
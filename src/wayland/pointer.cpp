@@ -3,6 +3,7 @@
 #include "engine.h"
 #include "wayland/wlr_compositor.h"
 #include "WindowManager/Space.h"
+#include "sceneDamage.h"
 extern "C" {
 #include <wlr/types/wlr_pointer.h>
 #include <wlr/types/wlr_cursor.h>
@@ -482,6 +483,7 @@ handle_pointer_motion(wl_listener* listener, void* data)
   auto* handle =
     wl_container_of(listener, static_cast<WlrPointerHandle*>(nullptr), motion);
   auto* event = static_cast<wlr_pointer_motion_event*>(data);
+  sceneDamage::mark();
   handle->server->input.delta_x += event->delta_x;
   handle->server->input.delta_y += event->delta_y;
   if (handle->server->relative_pointer_manager && handle->server->seat) {
@@ -537,6 +539,7 @@ handle_pointer_motion_abs(wl_listener* listener, void* data)
   auto* handle = wl_container_of(
     listener, static_cast<WlrPointerHandle*>(nullptr), motion_abs);
   auto* event = static_cast<wlr_pointer_motion_absolute_event*>(data);
+  sceneDamage::mark();
   if (handle->server->input.have_abs) {
     // Wayland absolute motion arrives normalized to [0,1]. Scale it back into
     // output-space units so nested sessions don't feel like they only have a
@@ -601,6 +604,7 @@ handle_pointer_axis(wl_listener* listener, void* data)
   auto* handle =
     wl_container_of(listener, static_cast<WlrPointerHandle*>(nullptr), axis);
   auto* event = static_cast<wlr_pointer_axis_event*>(data);
+  sceneDamage::mark();
   wlr_surface* preferred_surface = nullptr;
   if (handle->server && handle->server->seat &&
       handle->server->seat->pointer_state.focused_surface) {
@@ -628,6 +632,7 @@ void handle_pointer_button(wl_listener* listener, void* data)
   auto* handle =
     wl_container_of(listener, static_cast<WlrPointerHandle*>(nullptr), button);
   auto* event = static_cast<wlr_pointer_button_event*>(data);
+  sceneDamage::mark();
   bool button_consumed_by_controls = false;
   bool wayland_focus_requested =
     wayland_pointer_focus_requested(handle->server);
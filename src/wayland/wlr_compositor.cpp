@@ -9,6 +9,8 @@
 #include <memory>
 #include <drm_fourcc.h>
 #include <ctime>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <unordered_map>
 #include <EGL/egl.h>
 #include <wayland-server-core.h>
@@ -77,6 +79,9 @@ keysym_name(xkb_keysym_t sym)
 #include "screen.h"
 #include "Config.h"
 #include "controls.h"
+#include "sceneDamage.h"
+#include "time_utils.h"
+#include "tracy/Tracy.hpp"
 #include "wayland/wlr_compositor.h"
 #include "wayland/pointer.h"
 #include "wayland/keyboard.h"
@@ -1026,6 +1031,46 @@ ensure_depth_buffer(WlrOutputHandle* handle, int width, int height, GLuint fbo)
   }
 }
 
+// The focused app when it alone fills the output: its buffer is exactly the
+// output size and untransformed, and no subsurfaces, popups or layer shells
+// need compositing over it. The frame is then that buffer, unchanged.
+static WaylandApp*
+focused_fullscreen_app(WlrServer* server, int width, int height)
+{
+  if (!server->engine || !server->registry) {
+    return nullptr;
+  }
+  auto wm = server->engine->getWindowManager();
+  if (!wm) {
+    return nullptr;
+  }
+  auto focused = wm->getCurrentlyFocusedApp();
+  if (!focused || !server->registry->valid(*focused)) {
+    return nullptr;
+  }
+  auto* comp = server->registry->try_get<WaylandApp::Component>(*focused);
+  if (!comp || !comp->app || comp->accessory || comp->layer_shell) {
+    return nullptr;
+  }
+  wlr_surface* surface = comp->app->getSurface();
+  if (!surface || !surface->buffer ||
+      surface->buffer->base.width != width ||
+      surface->buffer->base.height != height ||
+      surface->current.transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+      surface->current.scale != 1 ||
+      !wl_list_empty(&surface->current.subsurfaces_below) ||
+      !wl_list_empty(&surface->current.subsurfaces_above)) {
+    return nullptr;
+  }
+  for (auto [entity, other] :
+       server->registry->view<WaylandApp::Component>().each()) {
+    if (other.layer_shell || (other.accessory && other.parent == *focused)) {
+      return nullptr;
+    }
+  }
+  return comp->app.get();
+}
+
 void
 handle_output_frame(wl_listener* listener, void* data)
 {
@@ -1072,7 +1117,10 @@ handle_output_frame(wl_listener* listener, void* data)
   GLuint fbo = wlr_gles2_renderer_get_buffer_fbo(server->renderer, buffer);
   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
   ensure_depth_buffer(handle, width, height, fbo);
-  auto submit_output_frame = [&](bool send_frame_done) {
+  // An unchanged frame is still begun and submitted (GL is only current
+  // inside the pass) but never committed (present == nullptr), so the
+  // swapchain buffer goes back unused and nothing is scanned out.
+  auto submit_output_frame = [&](bool send_frame_done, wlr_buffer* present) {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     wlr_render_pass_submit(pass);
@@ -1080,8 +1128,17 @@ handle_output_frame(wl_listener* listener, void* data)
     if (send_frame_done) {
       struct timespec now;
       clock_gettime(CLOCK_MONOTONIC, &now);
+      double nowSeconds = now.tv_sec + now.tv_nsec / 1e9;
       for (auto& entry : server->surface_map) {
         wlr_surface* root = entry.first;
+        // throttle clients nobody can see; their subsurfaces go with them
+        if (server->registry && server->registry->valid(entry.second)) {
+          auto* comp =
+            server->registry->try_get<WaylandApp::Component>(entry.second);
+          if (comp && comp->app && !comp->app->frameDoneDue(nowSeconds)) {
+            continue;
+          }
+        }
         wlr_surface_for_each_surface(
           root,
           [](wlr_surface* surface, int, int, void* data) {
@@ -1092,9 +1149,30 @@ handle_output_frame(wl_listener* listener, void* data)
       }
     }
 
-    wlr_output_state_set_buffer(&output_state, buffer);
-    if (!wlr_output_commit_state(handle->output, &output_state)) {
-      wlr_log(WLR_ERROR, "Failed to commit output frame");
+    if (present) {
+      wlr_output_state_set_buffer(&output_state, present);
+      if (!wlr_output_commit_state(handle->output, &output_state)) {
+        wlr_log(WLR_ERROR, "Failed to commit output frame");
+      } else if (server->engine && server->registry) {
+        if (auto* renderer = server->engine->getRenderer()) {
+          renderer->framePresented();
+        }
+        double presentedAt = nowSeconds();
+        for (auto& entry : server->surface_map) {
+          if (!server->registry->valid(entry.second)) {
+            continue;
+          }
+          auto* comp =
+            server->registry->try_get<WaylandApp::Component>(entry.second);
+          if (!comp || !comp->app) {
+            continue;
+          }
+          double latency = comp->app->getLatency().presented(presentedAt);
+          if (latency >= 0.0) {
+            TracyPlot("commit to present (ms)", latency * 1000.0);
+          }
+        }
+      }
     }
     wlr_output_state_finish(&output_state);
     wlr_buffer_unlock(buffer);
@@ -1180,20 +1258,74 @@ handle_output_frame(wl_listener* listener, void* data)
   }
 
   glViewport(0, 0, width, height);
-  server->engine->frame();
-  // Run screenshot capture after the frame has been drawn so the image matches
-  // what was just rendered.
-  if (server->engine && server->engine->getWindowManager() &&
-      server->engine->getRenderer()) {
-    auto wm = server->engine->getWindowManager();
-    if (wm && wm->consumeScreenshotRequest()) {
-      if (auto* renderer = server->engine->getRenderer()) {
-        renderer->screenshotFromCurrentFramebuffer(width, height, fbo);
+  WaylandApp* fullscreen = focused_fullscreen_app(server, width, height);
+  if (fullscreen) {
+    // renderApps doesn't run for it, so keep its commits marking the scene
+    fullscreen->setProjectedPixels(float(width) * float(height));
+  }
+  if (server->frame_wake_fd < 0) {
+    // nothing could wake an idle loop, so never let it go idle
+    sceneDamage::mark();
+  }
+  if (!server->engine->frame(fullscreen == nullptr)) {
+    // Clients still get frame-done so they keep drawing at their own pace;
+    // their commits mark the scene and wake us up.
+    submit_output_frame(true, nullptr);
+    double timeout = server->engine->idleTimeout();
+    if (server->idle_timer && timeout >= 0.0) {
+      wl_event_source_timer_update(server->idle_timer,
+                                   std::max(1, int(timeout * 1000.0)));
+    }
+    return;
+  }
+  auto wm = server->engine->getWindowManager();
+  auto* renderer = server->engine->getRenderer();
+  bool screenshotRequested = wm && wm->consumeScreenshotRequest();
+  bool captureRequested =
+    screenshotRequested || (renderer && renderer->captureRequested());
+  bool pointerLocked = wayland_pointer_locked(server);
+  // Draw a compositor-owned software cursor when either a Wayland surface has focus
+  // or the WM explicitly requested visibility (e.g., toggle_cursor hotkey).
+  bool cursorVisibleOverride = false;
+  if (wm) {
+    if (auto ov = wm->getCursorVisibleOverride()) {
+      cursorVisibleOverride = *ov;
+    }
+  }
+  bool compositorCursor =
+    !pointerLocked &&
+    (wayland_pointer_focus_requested(server) || cursorVisibleOverride);
+  // client cursors without a hardware plane are drawn into the frame too
+  bool softwareCursors = !pointerLocked &&
+                         handle->output->hardware_cursor == nullptr &&
+                         !wl_list_empty(&handle->output->cursors);
+
+  if (fullscreen) {
+    // Nothing else is on screen, so try handing the client's buffer to the
+    // output as is. Shm and unsupported dmabuf layouts fail the test and
+    // take a single blit instead.
+    if (!captureRequested && !compositorCursor && !softwareCursors) {
+      wlr_buffer* clientBuffer = &fullscreen->getSurface()->buffer->base;
+      wlr_output_state_set_buffer(&output_state, clientBuffer);
+      if (wlr_output_test_state(handle->output, &output_state)) {
+        fullscreen->getLatency().drawn(nowSeconds());
+        submit_output_frame(true, clientBuffer);
+        return;
       }
     }
+    if (renderer && !renderer->blitApp(fullscreen)) {
+      renderer->render();
+    }
+  }
+
+  // Run screenshot capture after the frame has been drawn so the image matches
+  // what was just rendered. The readback completes on a later frame.
+  if (renderer && screenshotRequested) {
+    renderer->screenshotFromCurrentFramebuffer(width, height, fbo);
+  } else if (renderer && captureRequested) {
+    renderer->captureFrame(width, height, fbo);
   }
 
-  bool pointerLocked = wayland_pointer_locked(server);
   // Render software cursors (clients set them via wl_pointer.set_cursor).
   if (!pointerLocked) {
     pixman_region32_t cursor_damage;
@@ -1201,27 +1333,13 @@ handle_output_frame(wl_listener* listener, void* data)
     wlr_output_add_software_cursors_to_render_pass(handle->output, pass, &cursor_damage);
     pixman_region32_fini(&cursor_damage);
   }
-  // Draw a compositor-owned software cursor when either a Wayland surface has focus
-  // or the WM explicitly requested visibility (e.g., toggle_cursor hotkey).
-  bool cursorVisibleOverride = false;
-  if (server->engine) {
-    if (auto wm = server->engine->getWindowManager()) {
-      if (auto ov = wm->getCursorVisibleOverride()) {
-        cursorVisibleOverride = *ov;
-      }
-    }
-  }
-  if (!pointerLocked &&
-      server->engine &&
-      (wayland_pointer_focus_requested(server) || cursorVisibleOverride)) {
-    if (auto* renderer = server->engine->getRenderer()) {
-      float sizePx = 24.0f * (handle->output ? handle->output->scale : 1.0f);
-      auto pointer = output_local_pointer(server, handle->output);
-      renderer->renderSoftwareCursor(pointer.first, pointer.second, sizePx);
-    }
+  if (compositorCursor && renderer) {
+    float sizePx = 24.0f * (handle->output ? handle->output->scale : 1.0f);
+    auto pointer = output_local_pointer(server, handle->output);
+    renderer->renderSoftwareCursor(pointer.first, pointer.second, sizePx);
   }
 
-  submit_output_frame(true);
+  submit_output_frame(true, buffer);
 }
 
 static void
@@ -1262,6 +1380,7 @@ handle_output_commit(wl_listener* listener, void* data)
                                    originY + output->height);
   }
 
+  sceneDamage::mark();
   std::fprintf(stderr, "output resized: %dx%d\n", handle->width, handle->height);
 }
 
@@ -1627,6 +1746,50 @@ WlrServer::register_listeners()
 
   new_input.notify = handle_new_input;
   wl_signal_add(&backend->events.new_input, &new_input);
+
+  wl_event_loop* loop = wl_display_get_event_loop(display);
+  frame_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (frame_wake_fd >= 0) {
+    frame_wake_source = wl_event_loop_add_fd(
+      loop,
+      frame_wake_fd,
+      WL_EVENT_READABLE,
+      [](int fd, uint32_t, void* data) {
+        uint64_t count;
+        while (read(fd, &count, sizeof(count)) > 0) {
+        }
+        static_cast<WlrServer*>(data)->schedule_frames();
+        return 0;
+      },
+      this);
+    int fd = frame_wake_fd;
+    sceneDamage::setWaker([fd]() {
+      uint64_t one = 1;
+      (void)!write(fd, &one, sizeof(one));
+    });
+  } else {
+    wlr_log(WLR_ERROR, "eventfd failed; rendering every frame");
+  }
+  idle_timer = wl_event_loop_add_timer(
+    loop,
+    [](void* data) {
+      static_cast<WlrServer*>(data)->schedule_frames();
+      return 0;
+    },
+    this);
+}
+
+void
+WlrServer::schedule_frames()
+{
+  if (!output_layout) {
+    return;
+  }
+  wlr_output_layout_output* entry;
+  wl_list_for_each(entry, &output_layout->outputs, link)
+  {
+    wlr_output_schedule_frame(entry->output);
+  }
 }
 
 bool
@@ -1688,6 +1851,19 @@ WlrServer::~WlrServer()
       wl_list_remove(&listener.link);
     }
   };
+  sceneDamage::setWaker(nullptr);
+  if (idle_timer) {
+    wl_event_source_remove(idle_timer);
+    idle_timer = nullptr;
+  }
+  if (frame_wake_source) {
+    wl_event_source_remove(frame_wake_source);
+    frame_wake_source = nullptr;
+  }
+  if (frame_wake_fd >= 0) {
+    close(frame_wake_fd);
+    frame_wake_fd = -1;
+  }
   if (engine) {
     engine.reset();
   }
@@ -17,16 +17,29 @@
 #include <vector>
 #include "systems/ApplyTranslation.h"
 #include "systems/Intersections.h"
+#include "systems/Light.h"
 #include "systems/Scripts.h"
+#include "systems/Simulation.h"
 #include "systems/Update.h"
 #include "utility.h"
 #include <csignal>
 #include "systems/ApplyRotation.h"
+#include "components/Door.h"
+#include "components/Key.h"
+#include "components/Light.h"
+#include "components/Lock.h"
+#include "components/Parent.h"
+#include "components/RotateMovement.h"
+#include "components/SimulatedTransform.h"
+#include "components/TranslateMovement.h"
 #include "tracy/Tracy.hpp"
 #include "time_utils.h"
+#include "Config.h"
 
 using namespace std;
 
+static const int MAX_SIMULATION_STEPS = 8;
+
 World::World(shared_ptr<EntityRegistry> registry,
              Camera* camera,
              shared_ptr<blocks::TexturePack> texturePack,
@@ -59,6 +72,88 @@ World::World(shared_ptr<EntityRegistry> registry,
     }
   }
   // } end class VoxelSpace (not implemented yet)
+  initSystems();
+}
+
+void
+World::initSystems()
+{
+  auto& r = *registry;
+  try {
+    float hz = Config::singleton()->get<float>("simulation_hz");
+    if (hz > 0) {
+      simulationStep = 1.0 / hz;
+    } else {
+      // a zero or negative step would never advance the simulation
+      logger->warn("simulation_hz must be positive, keeping {} Hz",
+                   1.0 / simulationStep);
+    }
+  } catch (...) {
+  }
+  try {
+    shadowUpdateBudget =
+      Config::singleton()->get<float>("shadow_update_budget_ms") / 1000.0;
+  } catch (...) {
+  }
+
+  simulation.add(
+    { .name = "beginSimulationStep",
+      .writes = systems::components<SimulatedTransform>(r),
+      .run = [this]() { systems::beginSimulationStep(registry); } });
+  // door/key/lock onFinish callbacks run from inside applyRotation
+  simulation.add(
+    { .name = "applyRotation",
+      .reads = systems::components<Positionable, Persistable>(r),
+      .writes = systems::
+        components<SimulatedTransform, RotateMovement, Door, Key, Lock>(r),
+      .run = [this]() { systems::applyRotation(registry, simulationStep); } });
+  simulation.add(
+    { .name = "applyTranslations",
+      .reads = systems::components<Positionable, Persistable>(r),
+      .writes = systems::components<SimulatedTransform, TranslateMovement>(r),
+      .run =
+        [this]() { systems::applyTranslations(registry, simulationStep); } });
+
+  scheduler.add(
+    { .name = "presentSimulation",
+      .reads = systems::components<TranslateMovement, RotateMovement>(r),
+      .writes = systems::components<Positionable, SimulatedTransform>(r),
+      .run =
+        [this]() { systems::presentSimulation(registry, simulationAlpha); } });
+  scheduler.add(
+    { .name = "updateAll",
+      .reads = systems::components<Model, Parent, Persistable>(r),
+      .writes = systems::components<Positionable, BoundingSphere, Light>(r),
+      .run = [this]() { systems::updateAll(registry); },
+      .mainThread = true });
+  // the shadow passes below and the next camera pass all draw from these;
+  // reading Light keeps it ordered before renderShadowMaps
+  scheduler.add({ .name = "uploadModelInstances",
+                  .reads = systems::components<Positionable, Model, Light>(r),
+                  .run = [this]() { renderer->updateModelInstances(); },
+                  .mainThread = true });
+  // draws, so it stays on the GL thread
+  scheduler.add({ .name = "renderShadowMaps",
+                  .reads = systems::components<Positionable, Model>(r),
+                  .writes = systems::components<Light>(r),
+                  .run =
+                    [this]() {
+                      systems::renderShadowMaps(
+                        registry, renderer, shadowUpdateBudget);
+                    },
+                  .mainThread = true });
+  scheduler.add({ .name = "flushDynamicObjects",
+                  .writes = systems::resources<DynamicObjectSpace>(),
+                  .run = [this]() { dynamicObjects->flushQueuedRemovals(); } });
+  scheduler.add({ .name = "uploadDynamicObjects",
+                  .reads = systems::resources<DynamicObjectSpace>(),
+                  .run =
+                    [this]() {
+                      if (dynamicObjects->damaged()) {
+                        renderer->updateDynamicObjects(dynamicObjects);
+                      }
+                    },
+                  .mainThread = true });
 }
 
 void
@@ -1269,13 +1364,21 @@ void
 World::tick()
 {
   ZoneScoped;
-  systems::applyRotation(registry);
-  systems::applyTranslations(registry);
-  systems::updateAll(registry, renderer);
-  dynamicObjects->flushQueuedRemovals();
-  if (dynamicObjects->damaged()) {
-    renderer->updateDynamicObjects(dynamicObjects);
+  double now = nowSeconds();
+  if (lastTick < 0) {
+    lastTick = now;
+  }
+  // after a long stall, drop time instead of trying to catch all of it up
+  simulationAccumulator +=
+    std::min(now - lastTick, MAX_SIMULATION_STEPS * simulationStep);
+  lastTick = now;
+  while (simulationAccumulator >= simulationStep) {
+    simulation.tick();
+    simulationAccumulator -= simulationStep;
   }
+  simulationAlpha = simulationAccumulator / simulationStep;
+
+  scheduler.tick();
   auto ids = dynamicObjects->getObjectIds();
   /*
   for(int i = 0; i < ids.size(); i++) {
@@ -0,0 +1,68 @@
+#include "appVisibility.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <gtest/gtest.h>
+
+static glm::mat4
+viewProjection()
+{
+  glm::mat4 projection =
+    glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+  glm::mat4 view = glm::lookAt(
+    glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  return projection * view;
+}
+
+static glm::mat4
+at(glm::vec3 position)
+{
+  return glm::translate(glm::mat4(1.0f), position);
+}
+
+// with a 90 degree fov the view is 2 units wide at distance 1, so a 1x1
+// quad there covers a quarter of each axis
+TEST(AppVisibility, quadInFrontCoversItsProjection)
+{
+  float area = projectedAppArea(
+    viewProjection(), at({ 0, 0, -1 }), 0.5f, 0.5f, 1000.0f, 1000.0f);
+  EXPECT_NEAR(area, 500.0f * 500.0f, 1.0f);
+
+  float farArea = projectedAppArea(
+    viewProjection(), at({ 0, 0, -10 }), 0.5f, 0.5f, 1000.0f, 1000.0f);
+  EXPECT_NEAR(farArea, 50.0f * 50.0f, 1.0f);
+}
+
+TEST(AppVisibility, quadsOutsideTheFrustumCoverNothing)
+{
+  glm::mat4 vp = viewProjection();
+  EXPECT_EQ(projectedAppArea(vp, at({ 0, 0, 5 }), 0.5f, 0.5f, 100, 100), 0.0f);
+  EXPECT_EQ(projectedAppArea(vp, at({ 20, 0, -5 }), 0.5f, 0.5f, 100, 100),
+            0.0f);
+  EXPECT_EQ(projectedAppArea(vp, at({ 0, 0, -500 }), 0.5f, 0.5f, 100, 100),
+            0.0f);
+}
+
+TEST(AppVisibility, partiallyVisibleQuadIsClippedToTheViewport)
+{
+  // half of the quad hangs off the right edge
+  float area = projectedAppArea(
+    viewProjection(), at({ 1, 0, -1 }), 0.5f, 0.5f, 1000.0f, 1000.0f);
+  EXPECT_NEAR(area, 250.0f * 500.0f, 1.0f);
+}
+
+TEST(AppVisibility, resolutionLodStepsWithHysteresis)
+{
+  const int w = 1600, h = 900;
+  const float full = float(w) * h;
+  EXPECT_EQ(resolutionLodLevel(0, full, w, h), 0);
+  // a quarter of the pixels is exactly half the resolution: not yet below
+  // the hysteresis band
+  EXPECT_EQ(resolutionLodLevel(0, full / 4, w, h), 0);
+  EXPECT_EQ(resolutionLodLevel(0, full / 8, w, h), 1);
+  // coming back to a quarter keeps the lower level
+  EXPECT_EQ(resolutionLodLevel(1, full / 4, w, h), 1);
+  EXPECT_EQ(resolutionLodLevel(1, full / 2, w, h), 0);
+  // far away: capped by the level limit and the minimum dimension
+  EXPECT_EQ(resolutionLodLevel(0, 10.0f, w, h), 2);
+  EXPECT_EQ(resolutionLodLevel(0, 10.0f, 3840, 2160), kMaxResolutionLod);
+  EXPECT_EQ(resolutionLodLevel(3, full, w, h), 0);
+}
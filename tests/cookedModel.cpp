@@ -0,0 +1,73 @@
+#include "cookedModel.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+static std::vector<MeshData>
+sampleMeshes()
+{
+  MeshData first;
+  first.vertices = { { glm::vec3(1, 2, 3), glm::vec2(0, 1), glm::vec3(0, 1, 0) },
+                     { glm::vec3(4, 5, 6), glm::vec2(1, 0), glm::vec3(1, 0, 0) },
+                     { glm::vec3(7, 8, 9), glm::vec2(1, 1), glm::vec3(0, 0, 1) } };
+  first.indices = { 0, 1, 2 };
+  first.textures = { { "texture_diffuse", "wood.png" },
+                     { "texture_specular", "a.png" } };
+  MeshData empty;
+  return { first, empty };
+}
+
+class CookedModelTest : public ::testing::Test
+{
+protected:
+  fs::path dir = fs::temp_directory_path() / "hackMatrixCookedModelTest";
+  void TearDown() override { fs::remove_all(dir); }
+};
+
+TEST_F(CookedModelTest, roundTripsMeshesAndBounds)
+{
+  auto path = cookedModelPath(dir.string(), 0xabcdef);
+  BoundingSphere bounds{ glm::vec3(4, 5, 6), 5.2f };
+  ASSERT_TRUE(writeCookedModel(path, sampleMeshes(), bounds));
+
+  std::vector<MeshData> meshes;
+  BoundingSphere readBounds;
+  ASSERT_TRUE(readCookedModel(path, meshes, readBounds));
+  auto expected = sampleMeshes();
+  ASSERT_EQ(meshes.size(), expected.size());
+  ASSERT_EQ(meshes[0].vertices.size(), 3);
+  ASSERT_EQ(meshes[0].vertices[2].Position, glm::vec3(7, 8, 9));
+  ASSERT_EQ(meshes[0].vertices[1].TexCoords, glm::vec2(1, 0));
+  ASSERT_EQ(meshes[0].indices, expected[0].indices);
+  ASSERT_EQ(meshes[0].textures, expected[0].textures);
+  ASSERT_TRUE(meshes[1].vertices.empty());
+  ASSERT_EQ(readBounds.center, bounds.center);
+  ASSERT_EQ(readBounds.radius, bounds.radius);
+}
+
+TEST_F(CookedModelTest, rejectsTruncatedFiles)
+{
+  auto path = cookedModelPath(dir.string(), 1);
+  ASSERT_TRUE(writeCookedModel(path, sampleMeshes(), BoundingSphere{}));
+  fs::resize_file(path, fs::file_size(path) - 6);
+
+  std::vector<MeshData> meshes;
+  BoundingSphere bounds;
+  ASSERT_FALSE(readCookedModel(path, meshes, bounds));
+  ASSERT_TRUE(meshes.empty());
+}
+
+TEST_F(CookedModelTest, hashFollowsContents)
+{
+  fs::create_directories(dir);
+  auto source = dir / "model.obj";
+  std::ofstream(source) << "v 0 0 0";
+  auto before = hashModelFile(source.string());
+  std::ofstream(source) << "v 0 0 1";
+  auto after = hashModelFile(source.string());
+  ASSERT_TRUE(before && after);
+  ASSERT_NE(*before, *after);
+  ASSERT_FALSE(hashModelFile((dir / "missing.obj").string()));
+}
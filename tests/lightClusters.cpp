@@ -0,0 +1,102 @@
+#include "lightClusters.h"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <gtest/gtest.h>
+#include <random>
+
+static const float NEAR = 0.1f, FAR = 400.0f;
+
+static LightClusters
+clusters()
+{
+  LightClusters clusters;
+  clusters.setProjection(
+    glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, NEAR, FAR), NEAR, FAR);
+  return clusters;
+}
+
+static std::vector<uint32_t>
+lightsOf(const LightClusters& clusters, int cluster)
+{
+  auto& ranges = clusters.getRanges();
+  auto& indices = clusters.getLightIndices();
+  auto begin = indices.begin() + ranges[cluster * 2];
+  return std::vector<uint32_t>(begin, begin + ranges[cluster * 2 + 1]);
+}
+
+// a point inside a light's sphere is lit by it in the point's own cluster
+TEST(LightClusters, pointsNearALightSeeIt)
+{
+  auto grid = clusters();
+  glm::mat4 projection =
+    glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, NEAR, FAR);
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> spread(-30.0f, 30.0f);
+  std::uniform_real_distribution<float> depth(1.0f, 200.0f);
+  LightSpheres lights;
+  for (int i = 0; i < 100; i++) {
+    lights.push(glm::vec3(spread(random), spread(random), -depth(random)),
+                5.0f);
+  }
+  grid.assign(lights);
+
+  for (int i = 0; i < lights.size(); i++) {
+    glm::vec3 point(lights.x[i] + 1.0f, lights.y[i], lights.z[i] + 1.0f);
+    glm::vec4 clip = projection * glm::vec4(point, 1.0f);
+    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+    if (glm::any(glm::greaterThan(glm::abs(ndc), glm::vec2(1.0f)))) {
+      continue;
+    }
+    auto lit = lightsOf(grid, grid.clusterAt(ndc, -point.z));
+    ASSERT_NE(std::find(lit.begin(), lit.end(), i), lit.end()) << i;
+  }
+}
+
+TEST(LightClusters, distantClustersDoNotListALight)
+{
+  auto grid = clusters();
+  LightSpheres lights;
+  lights.push(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f);
+  grid.assign(lights);
+  ASSERT_EQ(lightsOf(grid, grid.clusterAt(glm::vec2(0.0f), 10.0f)).size(), 1);
+  ASSERT_TRUE(lightsOf(grid, grid.clusterAt(glm::vec2(0.9f), 10.0f)).empty());
+  ASSERT_TRUE(lightsOf(grid, grid.clusterAt(glm::vec2(0.0f), 100.0f)).empty());
+}
+
+// lights sharing SIMD lanes, and the padded tail when the count isn't a
+// multiple of the lane width, must not change what any one light touches
+TEST(LightClusters, batchedLightsMatchSingleLights)
+{
+  auto grid = clusters();
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> spread(-80.0f, 80.0f);
+  std::uniform_real_distribution<float> depth(0.5f, 300.0f);
+  std::uniform_real_distribution<float> size(0.5f, 20.0f);
+  LightSpheres lights;
+  for (int i = 0; i < 37; i++) {
+    lights.push(glm::vec3(spread(random), spread(random), -depth(random)),
+                size(random));
+  }
+  grid.assign(lights);
+  auto fast = grid.getLightIndices();
+  auto fastRanges = grid.getRanges();
+
+  size_t total = 0;
+  for (int c = 0; c < grid.clusterCount(); c++) {
+    total += fastRanges[c * 2 + 1];
+  }
+  ASSERT_EQ(total, fast.size());
+
+  for (int i = 0; i < lights.size(); i++) {
+    LightSpheres one;
+    one.push(glm::vec3(lights.x[i], lights.y[i], lights.z[i]),
+             lights.radius[i]);
+    grid.assign(one);
+    for (int c = 0; c < grid.clusterCount(); c++) {
+      bool alone = grid.getRanges()[c * 2 + 1] == 1;
+      auto begin = fast.begin() + fastRanges[c * 2];
+      auto end = begin + fastRanges[c * 2 + 1];
+      ASSERT_EQ(alone, std::find(begin, end, i) != end) << i << " " << c;
+    }
+  }
+}
@@ -0,0 +1,94 @@
+#include "wayland/pixelConvert.h"
+#include <array>
+#include <drm_fourcc.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+// Straight from the fourcc definitions: each format is a little-endian
+// 32 bit word with the named channels from the most significant bits down.
+static std::array<uint8_t, 4>
+reference(uint32_t format, uint32_t v)
+{
+  auto byte = [&](int shift) { return uint8_t(v >> shift); };
+  auto ten = [&](int shift) { return uint8_t(((v >> shift) & 0x3FF) * 255 / 1023); };
+  uint8_t alpha2 = uint8_t((v >> 30) * 255 / 3);
+  switch (format) {
+    case DRM_FORMAT_ARGB8888:
+      return { byte(16), byte(8), byte(0), byte(24) };
+    case DRM_FORMAT_XRGB8888:
+      return { byte(16), byte(8), byte(0), 255 };
+    case DRM_FORMAT_ABGR8888:
+      return { byte(0), byte(8), byte(16), byte(24) };
+    case DRM_FORMAT_XBGR8888:
+      return { byte(0), byte(8), byte(16), 255 };
+    case DRM_FORMAT_BGRA8888:
+      return { byte(8), byte(16), byte(24), byte(0) };
+    case DRM_FORMAT_BGRX8888:
+      return { byte(8), byte(16), byte(24), 255 };
+    case DRM_FORMAT_RGBA8888:
+      return { byte(24), byte(16), byte(8), byte(0) };
+    case DRM_FORMAT_RGBX8888:
+      return { byte(24), byte(16), byte(8), 255 };
+    case DRM_FORMAT_ARGB2101010:
+      return { ten(20), ten(10), ten(0), alpha2 };
+    case DRM_FORMAT_XRGB2101010:
+      return { ten(20), ten(10), ten(0), 255 };
+    case DRM_FORMAT_ABGR2101010:
+      return { ten(0), ten(10), ten(20), alpha2 };
+    case DRM_FORMAT_XBGR2101010:
+      return { ten(0), ten(10), ten(20), 255 };
+  }
+  return {};
+}
+
+static const uint32_t FORMATS[] = {
+  DRM_FORMAT_ARGB8888,    DRM_FORMAT_XRGB8888,    DRM_FORMAT_ABGR8888,
+  DRM_FORMAT_XBGR8888,    DRM_FORMAT_BGRA8888,    DRM_FORMAT_BGRX8888,
+  DRM_FORMAT_RGBA8888,    DRM_FORMAT_RGBX8888,    DRM_FORMAT_ARGB2101010,
+  DRM_FORMAT_XRGB2101010, DRM_FORMAT_ABGR2101010, DRM_FORMAT_XBGR2101010,
+};
+
+// odd widths run both the vector loop and the scalar tail
+TEST(PixelConvert, everyFormatMatchesItsDefinition)
+{
+  std::mt19937 random(3);
+  for (int width : { 1, 7, 37, 64 }) {
+    std::vector<uint32_t> words(width);
+    for (auto& word : words) {
+      word = random();
+    }
+    std::vector<uint8_t> src(width * 4);
+    for (int x = 0; x < width; x++) {
+      for (int b = 0; b < 4; b++) {
+        src[x * 4 + b] = uint8_t(words[x] >> (b * 8));
+      }
+    }
+    for (uint32_t format : FORMATS) {
+      std::vector<uint8_t> dst(width * 4, 0xCD);
+      rowConverterFor(format)(src.data(), dst.data(), width);
+      for (int x = 0; x < width; x++) {
+        auto expected = reference(format, words[x]);
+        for (int c = 0; c < 4; c++) {
+          ASSERT_EQ(dst[x * 4 + c], expected[c])
+            << "format " << format << " width " << width << " pixel " << x
+            << " channel " << c;
+        }
+      }
+    }
+  }
+}
+
+TEST(PixelConvert, tenBitExtremesMapToFullRange)
+{
+  // 2 bit alpha, then red at full scale, green at zero, blue at full scale
+  uint32_t word = 0xFFF003FFu;
+  uint8_t src[4] = { uint8_t(word), uint8_t(word >> 8), uint8_t(word >> 16),
+                     uint8_t(word >> 24) };
+  uint8_t dst[4];
+  rowConverterFor(DRM_FORMAT_ARGB2101010)(src, dst, 1);
+  EXPECT_EQ(dst[0], 255);
+  EXPECT_EQ(dst[1], 0);
+  EXPECT_EQ(dst[2], 255);
+  EXPECT_EQ(dst[3], 255);
+}
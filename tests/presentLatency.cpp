@@ -0,0 +1,82 @@
+#include "presentLatency.h"
+#include <gtest/gtest.h>
+
+TEST(PresentLatency, timesEachBufferThroughItsStages)
+{
+  PresentLatency latency;
+  latency.committed(1.000);
+  latency.imported(1.002);
+  latency.drawn(1.005);
+  EXPECT_NEAR(latency.presented(1.010), 0.010, 1e-9);
+  // nothing new on the next output commit
+  EXPECT_LT(latency.presented(1.026), 0.0);
+
+  auto summary = latency.summary();
+  EXPECT_EQ(summary.samples, 1u);
+  EXPECT_EQ(summary.presented, 1u);
+  EXPECT_NEAR(summary.p50Ms, 10.0, 1e-3);
+  EXPECT_NEAR(summary.commitToImportMs, 2.0, 1e-3);
+  EXPECT_NEAR(summary.importToDrawMs, 3.0, 1e-3);
+  EXPECT_NEAR(summary.drawToPresentMs, 5.0, 1e-3);
+}
+
+TEST(PresentLatency, drawStampedBeforeImportKeepsStagesOrdered)
+{
+  // the frame started at 1.003, the texture was imported during it at 1.004
+  PresentLatency latency;
+  latency.committed(1.000);
+  latency.imported(1.004);
+  latency.drawn(1.003);
+  EXPECT_NEAR(latency.presented(1.010), 0.010, 1e-9);
+
+  auto summary = latency.summary();
+  EXPECT_NEAR(summary.commitToImportMs, 4.0, 1e-3);
+  EXPECT_NEAR(summary.importToDrawMs, 0.0, 1e-3);
+  EXPECT_NEAR(summary.drawToPresentMs, 6.0, 1e-3);
+}
+
+TEST(PresentLatency, supersededCommitsAreDropped)
+{
+  PresentLatency latency;
+  latency.committed(0.0);
+  latency.committed(0.004);
+  latency.drawn(0.006);
+  latency.presented(0.008);
+  auto summary = latency.summary();
+  EXPECT_EQ(summary.dropped, 1u);
+  // timed from the buffer that was actually shown
+  EXPECT_NEAR(summary.p50Ms, 4.0, 1e-3);
+
+  // hidden apps aren't waiting on anyone
+  latency.committed(1.0, false);
+  latency.committed(2.0, false);
+  latency.drawn(3.0);
+  EXPECT_LT(latency.presented(3.1), 0.0);
+  EXPECT_EQ(latency.summary().dropped, 1u);
+}
+
+TEST(PresentLatency, percentilesCoverTheRecentWindow)
+{
+  PresentLatency latency;
+  double t = 0.0;
+  for (int i = 1; i <= 100; i++) {
+    latency.committed(t);
+    latency.drawn(t);
+    latency.presented(t + i / 1000.0);
+    t += 1.0;
+  }
+  auto summary = latency.summary();
+  EXPECT_EQ(summary.samples, 100u);
+  EXPECT_NEAR(summary.p50Ms, 50.0, 0.01);
+  EXPECT_NEAR(summary.p95Ms, 95.0, 0.01);
+  EXPECT_NEAR(summary.p99Ms, 99.0, 0.01);
+
+  latency.resetSamples();
+  latency.committed(t);
+  latency.drawn(t);
+  latency.presented(t + 0.002);
+  summary = latency.summary();
+  EXPECT_EQ(summary.samples, 1u);
+  EXPECT_EQ(summary.presented, 101u);
+  EXPECT_NEAR(summary.p99Ms, 2.0, 0.01);
+}
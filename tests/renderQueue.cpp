@@ -0,0 +1,50 @@
+#include "renderQueue.h"
+#include <gtest/gtest.h>
+
+static DrawItem
+item(RenderPass pass, GLuint program, GLuint material, GLuint vertexArray)
+{
+  DrawItem drawItem;
+  drawItem.pass = pass;
+  drawItem.key = RenderQueue::makeKey(pass, program, material, vertexArray);
+  drawItem.vertexArray = vertexArray;
+  return drawItem;
+}
+
+TEST(RenderQueue, sortsByPassThenProgramThenMaterialThenVertexArray)
+{
+  RenderQueue queue;
+  queue.submit(item(MODEL_PASS, 1, 7, 3));
+  queue.submit(item(MODEL_PASS, 1, 2, 9));
+  queue.submit(item(DYNAMIC_OBJECT_PASS, 2, 0, 5));
+  queue.submit(item(MODEL_PASS, 1, 2, 4));
+  queue.sort();
+
+  auto& items = queue.getItems();
+  ASSERT_EQ(items.size(), 4);
+  ASSERT_EQ(items[0].pass, DYNAMIC_OBJECT_PASS);
+  ASSERT_EQ(items[1].vertexArray, 4);
+  ASSERT_EQ(items[2].vertexArray, 9);
+  ASSERT_EQ(items[3].vertexArray, 3);
+}
+
+TEST(RenderQueue, equalKeysKeepSubmissionOrder)
+{
+  RenderQueue queue;
+  for (int i = 0; i < 8; i++) {
+    auto drawItem = item(MODEL_PASS, 1, 2, 3);
+    drawItem.count = i;
+    queue.submit(drawItem);
+  }
+  queue.sort();
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(queue.getItems()[i].count, i);
+  }
+}
+
+TEST(RenderQueue, largeNamesDoNotReorderPasses)
+{
+  auto dynamic = RenderQueue::makeKey(DYNAMIC_OBJECT_PASS, ~0u, ~0u, ~0u);
+  auto model = RenderQueue::makeKey(MODEL_PASS, 0, 0, 0);
+  ASSERT_LT(dynamic, model);
+}
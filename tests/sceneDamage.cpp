@@ -0,0 +1,30 @@
+#include "sceneDamage.h"
+#include <gtest/gtest.h>
+
+TEST(SceneDamage, markIsConsumedOnce)
+{
+  sceneDamage::consume();
+  EXPECT_FALSE(sceneDamage::consume());
+  sceneDamage::mark();
+  sceneDamage::mark();
+  EXPECT_TRUE(sceneDamage::consume());
+  EXPECT_FALSE(sceneDamage::consume());
+}
+
+// an idle loop is woken by the first mark only; explicit wakes always go
+// through
+TEST(SceneDamage, onlyTheFirstMarkWakes)
+{
+  int wakes = 0;
+  sceneDamage::setWaker([&wakes]() { wakes++; });
+  sceneDamage::consume();
+  sceneDamage::mark();
+  sceneDamage::mark();
+  EXPECT_EQ(wakes, 1);
+  sceneDamage::consume();
+  sceneDamage::mark();
+  EXPECT_EQ(wakes, 2);
+  sceneDamage::wake();
+  EXPECT_EQ(wakes, 3);
+  sceneDamage::setWaker(nullptr);
+}
@@ -0,0 +1,87 @@
+#include "systems/Scheduler.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ResourceA
+{};
+struct ResourceB
+{};
+
+TEST(Scheduler, conflictingSystemsKeepRegistrationOrder)
+{
+  systems::Scheduler scheduler;
+  std::vector<int> order;
+  for (int i = 0; i < 3; i++) {
+    scheduler.add({ .name = "writer" + std::to_string(i),
+                    .writes = systems::resources<ResourceA>(),
+                    .run = [&order, i]() { order.push_back(i); } });
+  }
+  scheduler.tick();
+  ASSERT_EQ(order, (std::vector<int>{ 0, 1, 2 }));
+}
+
+TEST(Scheduler, readersWaitForEarlierWriter)
+{
+  systems::Scheduler scheduler;
+  std::atomic<int> value = 0;
+  std::atomic<int> seenByReaders = 0;
+  scheduler.add({ .name = "writer",
+                  .writes = systems::resources<ResourceA>(),
+                  .run = [&value]() { value = 42; } });
+  for (int i = 0; i < 2; i++) {
+    scheduler.add({ .name = "reader" + std::to_string(i),
+                    .reads = systems::resources<ResourceA>(),
+                    .run = [&value, &seenByReaders]() {
+                      seenByReaders += value;
+                    } });
+  }
+  scheduler.tick();
+  EXPECT_EQ(seenByReaders, 84);
+}
+
+TEST(Scheduler, mainThreadSystemsStayOnCallingThread)
+{
+  systems::Scheduler scheduler;
+  std::mutex mutex;
+  std::thread::id mainRanOn;
+  int independentRuns = 0;
+  scheduler.add({ .name = "independent",
+                  .writes = systems::resources<ResourceB>(),
+                  .run = [&]() {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    independentRuns++;
+                  } });
+  scheduler.add({ .name = "gl",
+                  .writes = systems::resources<ResourceA>(),
+                  .run = [&]() { mainRanOn = std::this_thread::get_id(); },
+                  .mainThread = true });
+  scheduler.tick();
+  EXPECT_EQ(mainRanOn, std::this_thread::get_id());
+  EXPECT_EQ(independentRuns, 1);
+  for (auto& system : scheduler.getSystems()) {
+    EXPECT_GE(system.lastMilliseconds, 0.0);
+  }
+}
+
+TEST(Scheduler, workersPersistAcrossTicks)
+{
+  systems::Scheduler scheduler;
+  std::vector<std::thread::id> workerIds;
+  scheduler.add({ .name = "first",
+                  .writes = systems::resources<ResourceA>(),
+                  .run = []() {} });
+  // runs next to "first", so on a worker
+  scheduler.add({ .name = "second",
+                  .writes = systems::resources<ResourceB>(),
+                  .run = [&]() {
+                    workerIds.push_back(std::this_thread::get_id());
+                  } });
+  scheduler.tick();
+  scheduler.tick();
+  ASSERT_EQ(workerIds.size(), 2u);
+  EXPECT_NE(workerIds[0], std::this_thread::get_id());
+  EXPECT_EQ(workerIds[0], workerIds[1]);
+}
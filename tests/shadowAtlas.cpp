@@ -0,0 +1,58 @@
+#include "shadowAtlas.h"
+#include <gtest/gtest.h>
+
+TEST(ShadowAtlas, mostRelevantLightsGetSlots)
+{
+  std::vector<uint32_t> none(2, NO_SHADOW);
+  auto assigned =
+    assignShadowSlots(none, { { 1, 0.1f }, { 2, 3.0f }, { 3, 2.0f } }, 2);
+  ASSERT_EQ(assigned, (std::vector<uint32_t>{ 2, 3 }));
+}
+
+TEST(ShadowAtlas, holdersKeepTheirSlot)
+{
+  std::vector<uint32_t> current = { 7, 4 };
+  auto assigned =
+    assignShadowSlots(current, { { 4, 5.0f }, { 7, 1.0f }, { 9, 2.0f } }, 2);
+  // 9 displaces 7, and 4 stays in slot 1
+  ASSERT_EQ(assigned, (std::vector<uint32_t>{ 9, 4 }));
+}
+
+TEST(ShadowAtlas, similarRelevanceDoesNotStealASlot)
+{
+  std::vector<uint32_t> current = { 1 };
+  auto assigned = assignShadowSlots(current, { { 1, 1.0f }, { 2, 1.1f } }, 1);
+  ASSERT_EQ(assigned[0], 1);
+  assigned = assignShadowSlots(current, { { 1, 1.0f }, { 2, 2.0f } }, 1);
+  ASSERT_EQ(assigned[0], 2);
+}
+
+TEST(ShadowAtlas, removedLightsFreeTheirSlot)
+{
+  std::vector<uint32_t> current = { 3, 5 };
+  auto assigned = assignShadowSlots(current, { { 5, 1.0f } }, 2);
+  ASSERT_EQ(assigned, (std::vector<uint32_t>{ NO_SHADOW, 5 }));
+}
+
+TEST(ShadowAtlas, resolutionFallsWithDistance)
+{
+  ASSERT_EQ(shadowResolution(10.0f, 50.0f), ShadowAtlas::SIZE);
+  ASSERT_EQ(shadowResolution(100.0f, 50.0f), ShadowAtlas::SIZE / 2);
+  ASSERT_EQ(shadowResolution(500.0f, 50.0f), ShadowAtlas::SIZE / 4);
+}
+
+TEST(ShadowAtlas, resolutionHoldsNearThresholds)
+{
+  const int full = ShadowAtlas::SIZE, half = ShadowAtlas::SIZE / 2;
+  // just past the 1x range threshold either way: no switch
+  ASSERT_EQ(shadowResolution(55.0f, 50.0f, full), full);
+  ASSERT_EQ(shadowResolution(45.0f, 50.0f, half), half);
+  // well past it: switch
+  ASSERT_EQ(shadowResolution(65.0f, 50.0f, full), half);
+  ASSERT_EQ(shadowResolution(40.0f, 50.0f, half), full);
+  // around the 3x threshold
+  ASSERT_EQ(shadowResolution(160.0f, 50.0f, half), half);
+  ASSERT_EQ(shadowResolution(190.0f, 50.0f, half), ShadowAtlas::SIZE / 4);
+  ASSERT_EQ(shadowResolution(140.0f, 50.0f, ShadowAtlas::SIZE / 4),
+            ShadowAtlas::SIZE / 4);
+}
@@ -0,0 +1,89 @@
+#include "Config.h"
+#include "components/Light.h"
+#include "entity.h"
+#include "model.h"
+#include "systems/Update.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+class ShadowInvalidation : public ::testing::Test
+{
+protected:
+  std::shared_ptr<EntityRegistry> registry;
+  entt::entity light;
+
+  void SetUp() override
+  {
+    auto configFile = fs::temp_directory_path() / "shadowInvalidation.yaml";
+    std::ofstream(configFile) << "database_file: \":memory:\"\n";
+    setenv("HACKMATRIX_CONFIG_FILE", configFile.c_str(), 1);
+    Config::_singleton = nullptr;
+
+    registry = std::make_shared<EntityRegistry>();
+    systems::trackDamage(registry);
+    light = registry->create();
+    registry->emplace<Positionable>(
+      light, glm::vec3(0), glm::vec3(0), glm::vec3(0), 1.0f);
+    registry->emplace<Light>(light, glm::vec3(1));
+    systems::updateAll(registry);
+  }
+
+  entt::entity addCaster(bool withModel)
+  {
+    auto caster = registry->create();
+    registry->emplace<Positionable>(
+      caster, glm::vec3(2, 0, 0), glm::vec3(0), glm::vec3(0), 1.0f);
+    if (withModel) {
+      registry->emplace<Model>(caster, "missing.obj");
+    }
+    systems::updateAll(registry);
+    return caster;
+  }
+
+  bool lightDirty() { return registry->get<Light>(light).shadowDirty; }
+
+  void clearLight() { registry->get<Light>(light).shadowDirty = false; }
+};
+
+// ADD_COMPONENT model on an entity that is already positioned, where the
+// shared asset is loaded and no load will damage it
+TEST_F(ShadowInvalidation, modelAddedToPositionedEntity)
+{
+  auto caster = addCaster(false);
+  clearLight();
+
+  registry->emplace<Model>(caster, "missing.obj");
+  systems::updateAll(registry);
+  EXPECT_TRUE(lightDirty());
+}
+
+TEST_F(ShadowInvalidation, casterDestroyed)
+{
+  auto caster = addCaster(true);
+  clearLight();
+
+  registry->destroy(caster);
+  EXPECT_TRUE(lightDirty());
+}
+
+TEST_F(ShadowInvalidation, modelRemoved)
+{
+  auto caster = addCaster(true);
+  clearLight();
+
+  registry->remove<Model>(caster);
+  EXPECT_TRUE(lightDirty());
+}
+
+TEST_F(ShadowInvalidation, destroyingNonCasterKeepsShadows)
+{
+  auto other = addCaster(false);
+  clearLight();
+
+  registry->destroy(other);
+  EXPECT_FALSE(lightDirty());
+}
@@ -0,0 +1,74 @@
+#include "transformBatch.h"
+#include <gtest/gtest.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+#include <vector>
+
+// The general path Positionable::update used before the closed form
+static void
+referenceTransform(glm::vec3 pos,
+                   glm::vec3 origin,
+                   glm::vec3 rotate,
+                   float scale,
+                   glm::mat4& model,
+                   glm::mat3& normal)
+{
+  model = glm::translate(glm::mat4(1.0f), pos);
+  model = model * glm::mat4_cast(glm::quat(glm::radians(rotate)));
+  model = glm::translate(model, origin * glm::vec3(-1));
+  model = glm::scale(model, glm::vec3(scale, scale, scale));
+  normal = glm::mat3(glm::transpose(glm::inverse(model)));
+}
+
+TEST(TransformBatch, matchesGeneralInverse)
+{
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> coord(-50.0f, 50.0f);
+  std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+  std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+  // odd count so the scalar tail runs after the SIMD lanes
+  const int count = 37;
+  TransformBatch batch;
+  std::vector<glm::vec3> pos, origin, rotate;
+  std::vector<float> scale;
+  for (int i = 0; i < count; i++) {
+    pos.push_back(glm::vec3(coord(rng), coord(rng), coord(rng)));
+    origin.push_back(glm::vec3(coord(rng), coord(rng), coord(rng)) * 0.1f);
+    rotate.push_back(glm::vec3(angle(rng), angle(rng), angle(rng)));
+    scale.push_back(size(rng));
+    batch.push(pos[i],
+               origin[i],
+               glm::quat(glm::radians(rotate[i])),
+               scale[i]);
+  }
+
+  std::vector<glm::mat4> models(count);
+  std::vector<glm::mat3> normals(count);
+  computeTransforms(batch, models.data(), normals.data());
+
+  for (int i = 0; i < count; i++) {
+    glm::mat4 expectedModel;
+    glm::mat3 expectedNormal;
+    referenceTransform(
+      pos[i], origin[i], rotate[i], scale[i], expectedModel, expectedNormal);
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 4; r++) {
+        EXPECT_NEAR(models[i][c][r], expectedModel[c][r], 1e-3f);
+      }
+    }
+    for (int c = 0; c < 3; c++) {
+      for (int r = 0; r < 3; r++) {
+        EXPECT_NEAR(normals[i][c][r], expectedNormal[c][r], 1e-3f);
+      }
+    }
+  }
+}
+
+TEST(TransformBatch, emptyBatchIsNoop)
+{
+  TransformBatch batch;
+  computeTransforms(batch, nullptr, nullptr);
+  EXPECT_EQ(batch.size(), 0);
+}
@@ -0,0 +1,65 @@
+#include "Config.h"
+#include "components/Parent.h"
+#include "entity.h"
+#include "model.h"
+#include "systems/Update.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+static std::shared_ptr<EntityRegistry>
+makeRegistry()
+{
+  auto configFile = fs::temp_directory_path() / "transformHierarchy.yaml";
+  std::ofstream(configFile) << "database_file: \":memory:\"\n";
+  setenv("HACKMATRIX_CONFIG_FILE", configFile.c_str(), 1);
+  Config::_singleton = nullptr;
+
+  auto registry = std::make_shared<EntityRegistry>();
+  registry->createTablesIfNeeded();
+  systems::trackDamage(registry);
+  return registry;
+}
+
+static entt::entity
+placed(std::shared_ptr<EntityRegistry> registry, glm::vec3 pos)
+{
+  auto entity = registry->createPersistent();
+  registry->emplace<Positionable>(
+    entity, pos, glm::vec3(0), glm::vec3(0), 1.0f);
+  return entity;
+}
+
+static void
+moveTo(std::shared_ptr<EntityRegistry> registry,
+       entt::entity entity,
+       glm::vec3 pos)
+{
+  auto& positionable = registry->get<Positionable>(entity);
+  positionable.pos = pos;
+  positionable.damage();
+}
+
+// Constructing any Positionable forces a rebuild during the same tick the
+// parent's move is applied; the child must follow rather than detach
+TEST(TransformHierarchy, parentMovedWhileRebuilding)
+{
+  auto registry = makeRegistry();
+  auto parent = placed(registry, glm::vec3(0));
+  auto child = placed(registry, glm::vec3(1, 0, 0));
+  int childId = registry->get<Persistable>(child).entityId;
+  registry->emplace<Parent>(parent, std::vector<int>{ childId });
+  systems::updateAll(registry);
+
+  moveTo(registry, parent, glm::vec3(5, 0, 0));
+  placed(registry, glm::vec3(-3, 0, 0));
+  systems::updateAll(registry);
+  EXPECT_EQ(registry->get<Positionable>(child).pos, glm::vec3(6, 0, 0));
+
+  moveTo(registry, parent, glm::vec3(10, 0, 0));
+  systems::updateAll(registry);
+  EXPECT_EQ(registry->get<Positionable>(child).pos, glm::vec3(11, 0, 0));
+}
@@ -959,6 +959,108 @@ TEST(WaylandMenuSpec, ReportsEngineStatusOverZmq)
   EXPECT_GE(resp.status().wayland_apps(), 0u);
 }
 
+// Frames come back over the API without touching the screenshots directory.
+TEST(WaylandMenuSpec, CapturesFrameOverZmq)
+{
+  auto h = start_compositor_with_env();
+  ScopeExit guard([&]() { stop_compositor(h); });
+  ASSERT_FALSE(h.pid.empty()) << "Failed to start compositor";
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+  const char* addr = std::getenv("VOXEL_API_ADDR_FOR_TEST");
+  std::string endpoint = addr ? addr : "tcp://127.0.0.1:3345";
+  auto capture = [&](bool raw, ApiRequestResponse* out) {
+    zmq::context_t ctx(1);
+    zmq::socket_t sock(ctx, zmq::socket_type::req);
+    sock.set(zmq::sockopt::rcvtimeo, 5000);
+    sock.set(zmq::sockopt::linger, 100);
+    sock.connect(endpoint);
+    ApiRequest req;
+    req.set_entityid(0);
+    req.set_type(MessageType::CAPTURE_FRAME);
+    req.mutable_captureframe()->set_raw(raw);
+    std::string data;
+    req.SerializeToString(&data);
+    zmq::message_t msg(data.size());
+    memcpy(msg.data(), data.data(), data.size());
+    if (!sock.send(msg, zmq::send_flags::none)) {
+      return false;
+    }
+    zmq::message_t reply;
+    if (!sock.recv(reply, zmq::recv_flags::none).has_value()) {
+      return false;
+    }
+    return out->ParseFromArray(reply.data(), reply.size());
+  };
+
+  ApiRequestResponse png;
+  ASSERT_TRUE(capture(false, &png)) << "No reply to CAPTURE_FRAME";
+  ASSERT_TRUE(png.success());
+  EXPECT_GT(png.frame().width(), 0u);
+  EXPECT_GT(png.frame().height(), 0u);
+  ASSERT_GE(png.frame().data().size(), 8u);
+  EXPECT_EQ(png.frame().data().substr(1, 3), "PNG");
+
+  ApiRequestResponse raw;
+  ASSERT_TRUE(capture(true, &raw)) << "No reply to raw CAPTURE_FRAME";
+  ASSERT_TRUE(raw.success());
+  EXPECT_EQ(raw.frame().data().size(),
+            size_t(raw.frame().width()) * raw.frame().height() * 4);
+}
+
+// A terminal redrawing under typed keys reports commit-to-present latency.
+TEST(WaylandMenuSpec, ReportsClientLatencyOverZmq)
+{
+  namespace fs = std::filesystem;
+
+  fs::path script = fs::temp_directory_path() / "menu-latency.sh";
+  {
+    std::ofstream out(script);
+    out << "#!/bin/bash\n"
+        << "exec foot\n";
+  }
+  fs::permissions(script,
+                  fs::perms::owner_exec | fs::perms::owner_read | fs::perms::owner_write,
+                  fs::perm_options::add);
+  std::ofstream("/tmp/menu-test.log", std::ios::trunc).close();
+  auto h = start_compositor_with_env("MATRIX_WLROOTS_OUTPUT=/tmp/menu-test.log "
+                                     "MENU_PROGRAM=" + script.string() + " ");
+  ScopeExit guard([&]() {
+    stop_compositor(h);
+    if (fs::exists(script)) {
+      fs::remove(script);
+    }
+  });
+  ASSERT_FALSE(h.pid.empty()) << "Failed to start compositor";
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+  ASSERT_TRUE(send_key_replay({ { "v", 0 } })) << "Failed to send menu launch key";
+  ASSERT_TRUE(wait_for_log_contains("/tmp/menu-test.log", "mapped", 200, 50))
+    << "Foot window never mapped";
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  ASSERT_TRUE(send_key_replay({ { "r", 0 }, { "Return", 120 } }))
+    << "Failed to focus terminal";
+  ASSERT_TRUE(send_key_replay(
+    { { "e", 80 }, { "c", 80 }, { "h", 80 }, { "o", 80 }, { "Return", 80 } }))
+    << "Failed to type into terminal";
+  std::this_thread::sleep_for(std::chrono::milliseconds(900));
+
+  ApiRequestResponse resp;
+  ASSERT_TRUE(fetch_status(&resp)) << "Failed to fetch status over ZMQ";
+  ASSERT_TRUE(resp.has_status());
+  const ClientLatency* foot = nullptr;
+  for (const auto& latency : resp.status().client_latency()) {
+    if (latency.samples() > 0) {
+      foot = &latency;
+    }
+  }
+  ASSERT_NE(foot, nullptr) << "No client reported presented frames";
+  EXPECT_GT(foot->presented(), 0u);
+  EXPECT_GE(foot->p50_ms(), 0.0);
+  EXPECT_LE(foot->p50_ms(), foot->p95_ms());
+  EXPECT_LE(foot->p95_ms(), foot->p99_ms());
+}
+
 // Verifies the key handler logs menu key presses.
 TEST(WaylandMenuSpec, LogsMenuKeypressInHandler)
 {